@@ -16,10 +16,109 @@
 #include <fstream>
 #include <algorithm>
 #include <initializer_list>
+#include <cstdint>
 #include <iterator>
 #include <iomanip>
 #include <climits>
 #include <type_traits>
+#include <array>
+#include <thread>
+#include <future>
+#include <exception>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+#include <unordered_map>
+#include <set>
+#include <atomic>
+#include <filesystem>
+#include <string_view>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ============ BUILD MODES ============
+// By default e-json is header-only and every function below is inline.
+// To compile the parser, serializer, path engine and file I/O only once,
+// define EJSON_COMPILED for every translation unit (e.g. -DEJSON_COMPILED)
+// and define EJSON_IMPLEMENTATION before including this header in exactly
+// one .cpp file.
+#if defined(EJSON_COMPILED)
+#define EJSON_INLINE
+#else
+#define EJSON_INLINE inline
+#endif
+
+// ============ TRACEPOINTS ============
+// Building with EJSON_ENABLE_USDT (Linux, GCC/Clang, x86-64 or AArch64) embeds
+// USDT probes under provider "ejson" for perf/bpftrace, with no systemtap
+// headers required:
+//   parse_start(bytes)         parse_done(bytes, ns)
+//   dump_start(pretty)         dump_done(bytes, ns)
+//   from_file_start(path)      from_file_done(bytes, ns)
+//   to_file_start(path)        to_file_done(bytes, ns)
+// e.g. bpftrace -e 'usdt:./server:ejson:parse_done { @ns = hist(arg1); }'
+// Every probe site is a single nop. Durations are only measured while a
+// *_done probe is attached (its semaphore is non-zero). Without
+// EJSON_ENABLE_USDT all of this compiles away.
+#if defined(EJSON_ENABLE_USDT) && defined(__linux__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+#include <chrono>
+#define EJSON_USDT_NOTE(probe, semaphore, args) \
+    "990: nop\n" \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+    ".balign 4\n" \
+    ".4byte 992f-991f, 994f-993f, 3\n" \
+    "991: .asciz \"stapsdt\"\n" \
+    "992: .balign 4\n" \
+    "993: .8byte 990b\n" \
+    ".8byte _.stapsdt.base\n" \
+    ".8byte " semaphore "\n" \
+    ".asciz \"ejson\"\n" \
+    ".asciz \"" #probe "\"\n" \
+    ".asciz \"" args "\"\n" \
+    "994: .balign 4\n" \
+    ".popsection\n" \
+    ".ifndef _.stapsdt.base\n" \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n" \
+    ".hidden _.stapsdt.base\n" \
+    "_.stapsdt.base: .space 1\n" \
+    ".size _.stapsdt.base, 1\n" \
+    ".popsection\n" \
+    ".endif\n"
+#define EJSON_USDT_SEMAPHORE(probe) ejson_##probe##_done_semaphore
+#define EJSON_USDT_DEFINE_SEMAPHORE(probe) \
+    inline volatile unsigned short EJSON_USDT_SEMAPHORE(probe) \
+        __asm__("ejson_" #probe "_done_semaphore") __attribute__((section(".probes"), used)) = 0;
+EJSON_USDT_DEFINE_SEMAPHORE(parse)
+EJSON_USDT_DEFINE_SEMAPHORE(dump)
+EJSON_USDT_DEFINE_SEMAPHORE(from_file)
+EJSON_USDT_DEFINE_SEMAPHORE(to_file)
+// Fires <probe>_start(arg) and starts the clock if <probe>_done is being traced.
+#define EJSON_TRACE_BEGIN(probe, arg) \
+    __asm__ __volatile__(EJSON_USDT_NOTE(probe##_start, "0", "8@%0") :: "nor"((unsigned long long)(arg))); \
+    const auto ejson_trace_start_ = EJSON_USDT_SEMAPHORE(probe) ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()
+// Fires <probe>_done(bytes, elapsed_ns) when it is being traced.
+#define EJSON_TRACE_END(probe, bytes) \
+    do { \
+        if (EJSON_USDT_SEMAPHORE(probe)) { \
+            long long ejson_trace_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - ejson_trace_start_).count(); \
+            __asm__ __volatile__(EJSON_USDT_NOTE(probe##_done, "ejson_" #probe "_done_semaphore", "8@%0 -8@%1") \
+                                 :: "nor"((unsigned long long)(bytes)), "nor"(ejson_trace_ns_)); \
+        } \
+    } while (0)
+#else
+#define EJSON_TRACE_BEGIN(probe, arg) ((void)0)
+#define EJSON_TRACE_END(probe, bytes) ((void)0)
+#endif
 
 namespace ejson {
 
@@ -27,8 +126,88 @@ struct JSONParseError : std::runtime_error {
     JSONParseError(const std::string& msg) : std::runtime_error("JSON Parse Error: " + msg) {}
 };
 
+// ============ BASE64 ============
+// Encodes bytes as standard, padded base64.
+EJSON_INLINE std::string base64_encode(const unsigned char* data, size_t len);
+EJSON_INLINE std::string base64_encode(const std::vector<unsigned char>& bytes);
+
+// Decodes base64 text and appends the bytes to out. Whitespace is skipped and
+// trailing padding is optional. Works directly on any character span.
+EJSON_INLINE void base64_decode(const char* data, size_t len, std::vector<unsigned char>& out);
+
+// Options for JSON::parse(s, options).
+struct ParseOptions {
+    // Share one immutable buffer among repeated string values ("2024-01-01",
+    // "application/json", ...) instead of allocating each occurrence. Only
+    // values without escapes are interned, and only those too long for
+    // std::string's inline buffer, since shorter ones never allocate. Keys
+    // are never interned.
+    bool intern_values = false;
+    size_t intern_max_length = 32;   // longer values are always decoded normally
+    size_t intern_capacity = 4096;   // dictionary slots per document; colliding values evict each other
+};
+
+namespace detail {
+    // Gzip detection and decoding used by from_file(). gunzip() throws once the
+    // inflated payload would exceed max_size bytes.
+    constexpr size_t default_max_inflated_size = size_t(1) << 30;   // 1 GiB
+    EJSON_INLINE bool is_gzip(std::istream& in);
+    EJSON_INLINE void gunzip(std::istream& in, std::string& out, size_t max_size = default_max_inflated_size);
+}
+
+// Result of JSON::dump_segments(): serialized output as an ordered list of
+// byte ranges, ready for writev()/sendmsg(). Structure and short or escaped
+// strings are copied into internal storage; long string values that need no
+// escaping are referenced in place, so the source JSON must stay alive and
+// unmodified while the segments are in use.
+struct DumpSegments {
+    struct Segment {
+        const char* data;
+        size_t size;
+    };
+    std::vector<Segment> segments;
+
+    DumpSegments() = default;
+    DumpSegments(const DumpSegments&) = delete;
+    DumpSegments& operator=(const DumpSegments&) = delete;
+    DumpSegments(DumpSegments&&) noexcept = default;
+    DumpSegments& operator=(DumpSegments&&) noexcept = default;
+
+    size_t total_size() const {
+        size_t total = 0;
+        for (const auto& seg : segments) total += seg.size;
+        return total;
+    }
+
+    std::string str() const {
+        std::string out;
+        out.reserve(total_size());
+        for (const auto& seg : segments) out.append(seg.data, seg.size);
+        return out;
+    }
+
+#if defined(__unix__) || defined(__APPLE__)
+    // Callers must split the list into batches of at most IOV_MAX entries.
+    std::vector<iovec> iovecs() const {
+        std::vector<iovec> iov(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            iov[i].iov_base = const_cast<char*>(segments[i].data);
+            iov[i].iov_len = segments[i].size;
+        }
+        return iov;
+    }
+#endif
+
+private:
+    friend struct JSON;
+    std::vector<char> storage;
+};
+
 struct JSON;
-using JSONValue = std::variant<std::nullptr_t, bool, double, std::string, std::vector<JSON>, std::map<std::string, JSON>>;
+// Immutable string storage shared by equal values (see ParseOptions::intern_values).
+// A JSON holding one is a string like any other.
+using SharedString = std::shared_ptr<const std::string>;
+using JSONValue = std::variant<std::nullptr_t, bool, double, std::string, std::vector<JSON>, std::map<std::string, JSON>, SharedString>;
 
 struct JSON {
     JSONValue value;
@@ -69,7 +248,7 @@ struct JSON {
     bool is_null() const { return std::holds_alternative<std::nullptr_t>(value); }
     bool is_bool() const { return std::holds_alternative<bool>(value); }
     bool is_number() const { return std::holds_alternative<double>(value); }
-    bool is_string() const { return std::holds_alternative<std::string>(value); }
+    bool is_string() const { return std::holds_alternative<std::string>(value) || std::holds_alternative<SharedString>(value); }
     bool is_array() const { return std::holds_alternative<std::vector<JSON>>(value); }
     bool is_object() const { return std::holds_alternative<std::map<std::string, JSON>>(value); }
     bool is_primitive() const { return is_null() || is_bool() || is_number() || is_string(); }
@@ -96,12 +275,13 @@ struct JSON {
     }
     
     const std::string& as_string() const { 
+        if (auto shared = std::get_if<SharedString>(&value)) return **shared;
         if (!is_string()) throw JSONParseError("Not a string"); 
         return std::get<std::string>(value); 
     }
     
     std::string as_string(const std::string& default_val) const {
-        return is_string() ? std::get<std::string>(value) : default_val;
+        return is_string() ? as_string() : default_val;
     }
     
     const std::vector<JSON>& as_array() const { 
@@ -114,6 +294,19 @@ struct JSON {
         return std::get<std::map<std::string, JSON>>(value); 
     }
 
+    // ============ BINARY (BASE64) ============
+    // Decodes a base64 string value into raw bytes.
+    std::vector<unsigned char> as_base64_bytes() const {
+        const std::string& text = as_string();
+        std::vector<unsigned char> bytes;
+        base64_decode(text.data(), text.size(), bytes);
+        return bytes;
+    }
+
+    // Stores bytes as a base64 string value.
+    void set_base64(const unsigned char* data, size_t len) { value = base64_encode(data, len); }
+    void set_base64(const std::vector<unsigned char>& bytes) { set_base64(bytes.data(), bytes.size()); }
+
     // ============ ARRAY ACCESS ============
     JSON& operator[](size_t idx) {
         if (is_null()) value = std::vector<JSON>{};
@@ -182,14 +375,14 @@ struct JSON {
     size_t size() const {
         if (is_array()) return std::get<std::vector<JSON>>(value).size();
         if (is_object()) return std::get<std::map<std::string, JSON>>(value).size();
-        if (is_string()) return std::get<std::string>(value).size();
+        if (is_string()) return as_string().size();
         return 0;
     }
 
     bool empty() const { 
         if (is_array()) return std::get<std::vector<JSON>>(value).empty();
         if (is_object()) return std::get<std::map<std::string, JSON>>(value).empty();
-        if (is_string()) return std::get<std::string>(value).empty();
+        if (is_string()) return as_string().empty();
         return is_null();
     }
 
@@ -201,6 +394,9 @@ struct JSON {
         arr.push_back(item);
     }
 
+    // push_front, pop_front, insert and erase shift every later element, so
+    // they are linear in the array's size. For queue-style editing of large
+    // arrays, use ArrayEditor, which makes front operations amortized O(1).
     void push_front(const JSON& item) {
         if (is_null()) value = std::vector<JSON>{};
         if (!is_array()) throw JSONParseError("Not an array");
@@ -208,6 +404,13 @@ struct JSON {
         arr.insert(arr.begin(), item);
     }
 
+    void pop_front() {
+        if (!is_array()) throw JSONParseError("Not an array");
+        auto& arr = std::get<std::vector<JSON>>(value);
+        if (arr.empty()) throw JSONParseError("Array is empty");
+        arr.erase(arr.begin());
+    }
+
     void pop_back() {
         if (!is_array()) throw JSONParseError("Not an array");
         auto& arr = std::get<std::vector<JSON>>(value);
@@ -254,92 +457,9 @@ struct JSON {
     }
 
     // ============ JSON PATH OPERATIONS ============
-    JSON at_path(const std::string& path) const {
-        const JSON* current = this;
-        size_t i = 0;
-        while(i < path.size()) {
-            if(path[i] == '.') { i++; continue; }
-            if(std::isalpha(path[i]) || path[i]=='_') {
-                size_t start = i;
-                while(i < path.size() && (std::isalnum(path[i]) || path[i]=='_')) i++;
-                std::string key = path.substr(start,i-start);
-                if(!current->is_object()) return JSON();
-                const auto& obj = current->as_object();
-                auto it = obj.find(key);
-                if (it == obj.end()) return JSON();
-                current = &it->second;
-            } else if(path[i]=='[') {
-                i++;
-                size_t start = i;
-                while(i < path.size() && std::isdigit(path[i])) i++;
-                if(i>=path.size() || path[i]!=']') throw JSONParseError("Expected closing bracket");
-                int idx = std::stoi(path.substr(start,i-start));
-                if(!current->is_array()) return JSON();
-                const auto& arr = current->as_array();
-                if (idx < 0 || static_cast<size_t>(idx) >= arr.size()) return JSON();
-                current = &arr[idx];
-                i++;
-            } else {
-                throw JSONParseError("Invalid character in path: " + std::string(1,path[i]));
-            }
-        }
-        return *current;
-    }
-
-    void set_path(const std::string& path, const JSON& val) {
-        JSON* current = this;
-        size_t i = 0;
-        std::vector<std::pair<std::string, int>> path_parts;
-        
-        while(i < path.size()) {
-            if(path[i] == '.') { i++; continue; }
-            if(std::isalpha(path[i]) || path[i]=='_') {
-                size_t start = i;
-                while(i < path.size() && (std::isalnum(path[i]) || path[i]=='_')) i++;
-                path_parts.push_back({path.substr(start,i-start), -1});
-            } else if(path[i]=='[') {
-                i++;
-                size_t start = i;
-                while(i < path.size() && std::isdigit(path[i])) i++;
-                if(i>=path.size() || path[i]!=']') throw JSONParseError("Expected closing bracket");
-                int idx = std::stoi(path.substr(start,i-start));
-                path_parts.push_back({"", idx});
-                i++;
-            } else {
-                throw JSONParseError("Invalid character in path: " + std::string(1,path[i]));
-            }
-        }
+    JSON at_path(const std::string& path) const;
 
-        for (size_t j = 0; j < path_parts.size(); ++j) {
-            bool is_last = (j == path_parts.size() - 1);
-            const auto& [key, index] = path_parts[j];
-            
-            if (index == -1) {
-                if (current->is_null()) *current = std::map<std::string, JSON>{};
-                if (!current->is_object()) throw JSONParseError("Expected object in path");
-                
-                if (is_last) {
-                    (*current)[key] = val;
-                } else {
-                    current = &(*current)[key];
-                }
-            } else {
-                if (current->is_null()) *current = std::vector<JSON>{};
-                if (!current->is_array()) throw JSONParseError("Expected array in path");
-                
-                auto& arr = std::get<std::vector<JSON>>(current->value);
-                if (arr.size() <= static_cast<size_t>(index)) {
-                    arr.resize(static_cast<size_t>(index) + 1);
-                }
-                
-                if (is_last) {
-                    arr[index] = val;
-                } else {
-                    current = &arr[index];
-                }
-            }
-        }
-    }
+    void set_path(const std::string& path, const JSON& val);
 
     bool has_path(const std::string& path) const {
         return !at_path(path).is_null();
@@ -347,121 +467,46 @@ struct JSON {
 
     // ============ COMPARISON OPERATORS ============
     bool operator==(const JSON& other) const {
+        if (is_string() && other.is_string()) return as_string() == other.as_string();
         return value == other.value;
     }
     bool operator!=(const JSON& other) const {
         return !(*this == other);
     }
     
-    bool operator<(const JSON& other) const {
-        if (value.index() != other.value.index()) {
-            return value.index() < other.value.index();
-        }
-        return std::visit(
-            [](const auto& lhs, const auto& rhs) -> bool {
-                if constexpr (std::is_same_v<decltype(lhs), decltype(rhs)>) {
-                    using T = std::decay_t<decltype(lhs)>;
-                    if constexpr (std::is_same_v<T, std::nullptr_t>) {
-                        return false;
-                    } else {
-                        return lhs < rhs;
-                    }
-                } else {
-                    return false;
-                }
-            },
-            value, other.value
-        );
-    }
+    bool operator<(const JSON& other) const;
 
     // ============ SERIALIZATION ============
-    std::string dump(bool pretty = false, int indent = 0, int indent_size = 2, int max_precision = 6) const {
-        std::ostringstream oss;
-        
-        if (is_null()) { 
-            oss << "null"; 
-        }
-        else if (is_bool()) { 
-            oss << (std::get<bool>(value) ? "true" : "false"); 
-        }
-        else if (is_number()) { 
-            double num = std::get<double>(value);
-            if (num == static_cast<long long>(num) && num >= LLONG_MIN && num <= LLONG_MAX) {
-                oss << static_cast<long long>(num);
-            } else {
-                oss << std::setprecision(max_precision) << std::noshowpoint << num;
-            }
-        }
-        else if (is_string()) {
-            oss << '"';
-            for (auto c : std::get<std::string>(value)) {
-                switch(c) {
-                    case '\"': oss << "\\\""; break;
-                    case '\\': oss << "\\\\"; break;
-                    case '\b': oss << "\\b"; break;
-                    case '\f': oss << "\\f"; break;
-                    case '\n': oss << "\\n"; break;
-                    case '\r': oss << "\\r"; break;
-                    case '\t': oss << "\\t"; break;
-                    default: 
-                        if (c < 32 || c == 127) {
-                            oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
-                        } else {
-                            oss << c;
-                        }
-                }
-            }
-            oss << '"';
-        }
-        else if (is_array()) {
-            const auto& arr = std::get<std::vector<JSON>>(value);
-            oss << "[";
-            bool first = true;
-            for (const auto& el : arr) {
-                if (!first) oss << ",";
-                first = false;
-                if (pretty) oss << "\n" << std::string(indent + indent_size,' ');
-                oss << el.dump(pretty, indent + indent_size, indent_size, max_precision);
-            }
-            if (pretty && !arr.empty()) oss << "\n" << std::string(indent,' ');
-            oss << "]";
-        }
-        else if (is_object()) {
-            const auto& obj = std::get<std::map<std::string, JSON>>(value);
-            oss << "{";
-            bool first = true;
-            for (const auto& [k,v] : obj) {
-                if (!first) oss << ",";
-                first = false;
-                if (pretty) oss << "\n" << std::string(indent + indent_size,' ');
-                oss << '"' << k << "\":" << (pretty ? " " : "") << v.dump(pretty, indent + indent_size, indent_size, max_precision);
-            }
-            if (pretty && !obj.empty()) oss << "\n" << std::string(indent,' ');
-            oss << "}";
-        }
-        return oss.str();
-    }
+    std::string dump(bool pretty = false, int indent = 0, int indent_size = 2, int max_precision = 6) const;
 
     std::string dump_minified() const { return dump(false); }
     std::string dump_pretty(int indent_size = 2) const { return dump(true, 0, indent_size, 6); }
 
+    // Writes the same text as dump(pretty, 0, indent_size, max_precision) into
+    // buf without allocating and returns the number of bytes the full output
+    // needs. If that is larger than cap the output was cut off; retry with a
+    // bigger buffer. The output is not NUL-terminated.
+    size_t dump_into(char* buf, size_t cap, bool pretty = false, int indent_size = 2, int max_precision = 6) const;
+
+    // Exact length of dump(pretty, 0, indent_size, max_precision), computed without allocating.
+    size_t serialized_size(bool pretty = false, int indent_size = 2, int max_precision = 6) const;
+
+    // Serializes like dump() but returns scatter-gather segments: string values
+    // of at least reference_threshold bytes that need no escaping are referenced
+    // instead of copied.
+    DumpSegments dump_segments(size_t reference_threshold = 4096, bool pretty = false, int indent_size = 2, int max_precision = 6) const;
+
+    // ============ FROZEN FORM ============
+    // Encodes the document into a relocatable, read-only binary layout that
+    // FrozenJSON can query in place (e.g. from shared memory or a mapped file).
+    std::string freeze() const;
+
     // ============ FILE I/O ============
-    static JSON from_file(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            throw JSONParseError("Cannot open file: " + filename);
-        }
-        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        return parse(content);
-    }
+    // Gzip-compressed files (.gz) are detected by their magic bytes and inflated transparently.
+    // Inflation stops with an error past max_inflated_size bytes, guarding against gzip bombs.
+    static JSON from_file(const std::string& filename, size_t max_inflated_size = detail::default_max_inflated_size);
 
-    void to_file(const std::string& filename, bool pretty = true) const {
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            throw JSONParseError("Cannot write to file: " + filename);
-        }
-        file << dump(pretty);
-    }
+    void to_file(const std::string& filename, bool pretty = true) const;
 
     // ============ STREAM OPERATORS ============
     friend std::ostream& operator<<(std::ostream& os, const JSON& json) {
@@ -476,16 +521,7 @@ struct JSON {
     }
 
     // ============ MERGE AND FLATTEN ============
-    void merge(const JSON& other) {
-        if (!is_object() || !other.is_object()) {
-            throw JSONParseError("Can only merge objects");
-        }
-        auto& obj = std::get<std::map<std::string, JSON>>(value);
-        const auto& other_obj = other.as_object();
-        for (const auto& [key, val] : other_obj) {
-            obj[key] = val;
-        }
-    }
+    void merge(const JSON& other);
 
     JSON flattened(const std::string& separator = ".") const {
         JSON result = std::map<std::string, JSON>{};
@@ -587,29 +623,20 @@ struct JSON {
     }
 
     // ============ PARSING WITH ENHANCED ERROR REPORTING ============
-    static JSON parse(const std::string& s) {
-        size_t idx = 0;
-        try {
-            JSON result = parse_value(s, idx);
-            skip_ws(s, idx);
-            if (idx < s.size()) {
-                throw JSONParseError("Extra characters after JSON at position " + std::to_string(idx));
-            }
-            return result;
-        } catch (const std::exception& e) {
-            throw JSONParseError("Parse error at position " + std::to_string(idx) + ": " + e.what());
-        }
-    }
+    static JSON parse(const std::string& s);
+
+    static JSON parse(const std::string& s, const ParseOptions& options);
+
+    // ============ PARALLEL PARSING ============
+    // Parses one large top-level array or object on several threads.
+    // A chunked pre-pass resolves string/escape state and nesting depth so the
+    // container can be cut at top-level commas; each segment is then parsed
+    // concurrently and the results are stitched back in order.
+    // Small inputs and scalar documents fall back to parse().
+    static JSON parse_parallel(const std::string& s, unsigned threads = 0, const ParseOptions& options = ParseOptions());
 
     // ============ VALIDATION ============
-    static bool is_valid(const std::string& s) {
-        try {
-            parse(s);
-            return true;
-        } catch (...) {
-            return false;
-        }
-    }
+    static bool is_valid(const std::string& s);
 
     // ============ UTILITY FUNCTIONS ============
     JSON deep_copy() const {
@@ -627,231 +654,3466 @@ struct JSON {
     }
 
 private:
-    // ============ HELPER FUNCTIONS ============
-    static void flatten_recursive(const JSON& obj, const std::string& prefix, JSON& result, const std::string& sep) {
-        if (obj.is_object()) {
-            for (const auto& [key, value] : obj.as_object()) {
-                std::string new_key = prefix.empty() ? key : prefix + sep + key;
-                if (value.is_object() || value.is_array()) {
-                    flatten_recursive(value, new_key, result, sep);
-                } else {
-                    result[new_key] = value;
-                }
-            }
-        } else if (obj.is_array()) {
-            for (size_t i = 0; i < obj.size(); ++i) {
-                std::string new_key = prefix + "[" + std::to_string(i) + "]";
-                if (obj[i].is_object() || obj[i].is_array()) {
-                    flatten_recursive(obj[i], new_key, result, sep);
-                } else {
-                    result[new_key] = obj[i];
-                }
+    friend class Template;
+    friend class ArrayEditor;
+    friend class CachedDocument;
+
+    // ============ VALUE INTERNING ============
+    // Bounded, direct-mapped dictionary of string values seen in one document.
+    // A hit hands out the stored buffer, so equal values share it.
+    class ValueInterner {
+    public:
+        explicit ValueInterner(const ParseOptions& options) : max_length(options.intern_max_length) {
+            if (!options.intern_values || options.intern_capacity == 0 || max_length <= inline_length) return;
+            size_t capacity = 1;
+            while (capacity < options.intern_capacity) capacity <<= 1;
+            slots.resize(capacity);
+        }
+
+        bool enabled() const { return !slots.empty(); }
+        size_t max_value_length() const { return max_length; }
+
+        JSON get(const char* data, size_t len) {
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < len; ++i) hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+            Slot& slot = slots[hash & (slots.size() - 1)];
+            if (!slot.text || slot.hash != hash || slot.text->compare(0, std::string::npos, data, len) != 0) {
+                slot.text = std::make_shared<const std::string>(data, len);
+                slot.hash = hash;
             }
-        } else {
-            result[prefix] = obj;
+            JSON out;
+            out.value = slot.text;
+            return out;
+        }
+
+        // Values up to this length live inside std::string and never allocate.
+        static inline const size_t inline_length = std::string().capacity();
+
+    private:
+        struct Slot {
+            SharedString text;
+            size_t hash = 0;
+        };
+        std::vector<Slot> slots;
+        size_t max_length;
+    };
+
+    // ============ SERIALIZATION WRITER ============
+    // Output sinks for write_value(): a growing string, a fixed caller buffer
+    // (counts past the end without writing) and a plain byte counter.
+    struct StringSink {
+        std::string& out;
+        void put(char c) { out += c; }
+        void put(const char* data, size_t len) { out.append(data, len); }
+        void fill(char c, size_t len) { out.append(len, c); }
+    };
+
+    struct BufferSink {
+        char* buf;
+        size_t cap;
+        size_t size = 0;
+        void put(char c) {
+            if (size < cap) buf[size] = c;
+            size++;
+        }
+        void put(const char* data, size_t len) {
+            if (size < cap) std::memcpy(buf + size, data, std::min(len, cap - size));
+            size += len;
+        }
+        void fill(char c, size_t len) {
+            if (size < cap) std::memset(buf + size, c, std::min(len, cap - size));
+            size += len;
+        }
+    };
+
+    struct CountingSink {
+        size_t size = 0;
+        void put(char) { size++; }
+        void put(const char*, size_t len) { size += len; }
+        void fill(char, size_t len) { size += len; }
+    };
+
+    struct ScatterSink {
+        struct Piece {
+            const char* ref;   // referenced bytes, or nullptr for a range of storage
+            size_t offset;
+            size_t size;
+        };
+        std::vector<char>& storage;
+        std::vector<Piece>& pieces;
+        size_t threshold;
+        size_t run_start = 0;
+
+        void put(char c) { storage.push_back(c); }
+        void put(const char* data, size_t len) { storage.insert(storage.end(), data, data + len); }
+        void fill(char c, size_t len) { storage.insert(storage.end(), len, c); }
+        void flush() {
+            if (storage.size() > run_start) pieces.push_back({nullptr, run_start, storage.size() - run_start});
+            run_start = storage.size();
+        }
+        bool reference(const std::string& str) {
+            if (str.size() < threshold || find_escape(str.data(), str.size()) != str.size()) return false;
+            flush();
+            pieces.push_back({str.data(), 0, str.size()});
+            return true;
+        }
+    };
+
+    // Index of the first byte that needs escaping in a JSON string, or len.
+    // Scans eight bytes per step and only drops to bytes inside a flagged word.
+    static size_t find_escape(const char* data, size_t len) {
+        const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            uint64_t control = (w - ones * 0x20) & ~w;
+            uint64_t quote = w ^ (ones * '"');
+            uint64_t backslash = w ^ (ones * '\\');
+            uint64_t del = w ^ (ones * 0x7F);
+            uint64_t hits = control | ((quote - ones) & ~quote) | ((backslash - ones) & ~backslash) | ((del - ones) & ~del);
+            if (hits & highs) break;
+        }
+        for (; i < len; ++i) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            if (c < 32 || c == '"' || c == '\\' || c == 127) return i;
         }
+        return len;
     }
 
-    static void skip_ws(const std::string& s, size_t& idx) {
-        while(idx < s.size() && std::isspace(s[idx])) idx++;
+    template<typename Sink>
+    void write_value(Sink& sink, bool pretty, int indent, int indent_size, int max_precision) const;
+
+    template<typename Sink>
+    static void write_number(Sink& sink, double num, int max_precision);
+
+    template<typename Sink>
+    static void write_string(Sink& sink, std::string_view str);
+
+    template<typename Sink>
+    static void write_escaped(Sink& sink, std::string_view str);
+
+    // ============ HELPER FUNCTIONS ============
+    static void flatten_recursive(const JSON& obj, const std::string& prefix, JSON& result, const std::string& sep);
+
+    static void skip_ws(const std::string& s, size_t& idx);
+
+    // ============ PARALLEL PARSE HELPERS ============
+    static constexpr size_t parallel_min_chunk = 1 << 20;
+
+    template<typename Fn>
+    static void run_chunks(size_t count, Fn fn) {
+        std::vector<std::future<void>> pending;
+        for (size_t c = 1; c < count; ++c) pending.push_back(std::async(std::launch::async, fn, c));
+        std::exception_ptr failure;
+        try { fn(0); } catch (...) { failure = std::current_exception(); }
+        for (auto& f : pending) {
+            try { f.get(); } catch (...) { if (!failure) failure = std::current_exception(); }
+        }
+        if (failure) std::rethrow_exception(failure);
     }
+
+    // String scanner states: 0 = outside a string, 1 = inside, 2 = inside right after a backslash.
+    static unsigned char next_string_state(unsigned char state, char c);
+
+    static std::array<unsigned char, 3> scan_string_state(const std::string& s, size_t begin, size_t end);
+
+    static long long scan_depth_delta(const std::string& s, size_t begin, size_t end, unsigned char state);
+
+    static size_t find_top_level_comma(const std::string& s, size_t begin, size_t end, unsigned char state, long long depth);
+
+    // Parses the comma-separated members between idx and stop (a split comma),
+    // or up to the container's closing bracket when stop is npos.
+    static JSON parse_segment(const std::string& s, size_t& idx, size_t stop, char open, ValueInterner* interner);
     
-    static void encode_utf8(std::string& res, int codepoint) {
-        if (codepoint <= 0x7F) {
-            res += static_cast<char>(codepoint);
-        } else if (codepoint <= 0x7FF) {
-            res += static_cast<char>(0xC0 | (codepoint >> 6));
-            res += static_cast<char>(0x80 | (codepoint & 0x3F));
-        } else if (codepoint <= 0xFFFF) {
-            res += static_cast<char>(0xE0 | (codepoint >> 12));
-            res += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-            res += static_cast<char>(0x80 | (codepoint & 0x3F));
-        } else if (codepoint <= 0x10FFFF) {
-            res += static_cast<char>(0xF0 | (codepoint >> 18));
-            res += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
-            res += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-            res += static_cast<char>(0x80 | (codepoint & 0x3F));
-        }
-    }
-
-
-    static JSON parse_value(const std::string& s, size_t& idx) {
-        skip_ws(s, idx);
-        if(idx >= s.size()) throw JSONParseError("Unexpected end of input");
+    static void encode_utf8(std::string& res, int codepoint);
 
-        char c = s[idx];
-        if(c=='n') return parse_null(s, idx);
-        else if(c=='t' || c=='f') return parse_bool(s, idx);
-        else if(c=='\"') return parse_string(s, idx);
-        else if(c=='[') return parse_array(s, idx);
-        else if(c=='{') return parse_object(s, idx);
-        else if(c=='-' || std::isdigit(c)) return parse_number(s, idx);
-        throw JSONParseError(std::string("Unexpected character: ")+c);
-    }
 
-    static JSON parse_null(const std::string& s, size_t& idx) {
-        if(idx + 4 > s.size() || s.substr(idx,4)!="null") throw JSONParseError("Invalid null");
-        idx+=4;
-        return JSON(nullptr);
-    }
+    static JSON parse_value(const std::string& s, size_t& idx, ValueInterner* interner = nullptr);
 
-    static JSON parse_bool(const std::string& s, size_t& idx) {
-        if(idx + 4 <= s.size() && s.substr(idx,4)=="true") { idx+=4; return JSON(true); }
-        if(idx + 5 <= s.size() && s.substr(idx,5)=="false") { idx+=5; return JSON(false); }
-        throw JSONParseError("Invalid boolean");
-    }
+    static JSON parse_null(const std::string& s, size_t& idx);
 
-    static JSON parse_number(const std::string& s, size_t& idx) {
-        size_t start = idx;
-        if(s[idx]=='-') idx++;
-        if(idx >= s.size() || !std::isdigit(s[idx])) throw JSONParseError("Invalid number");
-        
-        if(s[idx] == '0') {
-            idx++;
+    static JSON parse_bool(const std::string& s, size_t& idx);
+
+    static JSON parse_number(const std::string& s, size_t& idx);
+
+    static JSON parse_string(const std::string& s, size_t& idx);
+
+    static JSON parse_interned_string(const std::string& s, size_t& idx, ValueInterner& interner);
+
+    static JSON parse_array(const std::string& s, size_t& idx, ValueInterner* interner = nullptr);
+
+    static JSON parse_object(const std::string& s, size_t& idx, ValueInterner* interner = nullptr);
+};
+
+// ============ SERIALIZATION WRITER ============
+template<typename Sink>
+void JSON::write_value(Sink& sink, bool pretty, int indent, int indent_size, int max_precision) const {
+    if (is_null()) {
+        sink.put("null", 4);
+    }
+    else if (is_bool()) {
+        if (std::get<bool>(value)) sink.put("true", 4);
+        else sink.put("false", 5);
+    }
+    else if (is_number()) {
+        write_number(sink, std::get<double>(value), max_precision);
+    }
+    else if (is_string()) {
+        const auto& str = as_string();
+        if constexpr (std::is_same_v<Sink, ScatterSink>) {
+            sink.put('"');
+            if (!sink.reference(str)) write_escaped(sink, str);
+            sink.put('"');
         } else {
-            while(idx<s.size() && std::isdigit(s[idx])) idx++;
-        }
-        
-        if(idx<s.size() && s[idx]=='.') { 
-            idx++; 
-            if(idx >= s.size() || !std::isdigit(s[idx])) throw JSONParseError("Invalid number: missing digits after decimal point");
-            while(idx<s.size() && std::isdigit(s[idx])) idx++; 
+            write_string(sink, str);
         }
-        
-        if(idx<s.size() && (s[idx]=='e' || s[idx]=='E')) {
-            idx++;
-            if(idx<s.size() && (s[idx]=='+' || s[idx]=='-')) idx++;
-            if(idx >= s.size() || !std::isdigit(s[idx])) throw JSONParseError("Invalid number: missing digits in exponent");
-            while(idx<s.size() && std::isdigit(s[idx])) idx++;
+    }
+    else if (is_array()) {
+        sink.put('[');
+        bool first = true;
+        for (const auto& item : std::get<std::vector<JSON>>(value)) {
+            if (!first) sink.put(',');
+            first = false;
+            if (pretty) { sink.put('\n'); sink.fill(' ', indent + indent_size); }
+            item.write_value(sink, pretty, indent + indent_size, indent_size, max_precision);
         }
-        
-        try {
-            double num = std::stod(s.substr(start, idx-start));
-            return JSON(num);
-        } catch (const std::exception&) {
-            throw JSONParseError("Invalid number format");
+        if (pretty && !empty()) { sink.put('\n'); sink.fill(' ', indent); }
+        sink.put(']');
+    }
+    else if (is_object()) {
+        const auto& obj = std::get<std::map<std::string, JSON>>(value);
+        sink.put('{');
+        bool first = true;
+        for (const auto& [k, v] : obj) {
+            if (!first) sink.put(',');
+            first = false;
+            if (pretty) { sink.put('\n'); sink.fill(' ', indent + indent_size); }
+            write_string(sink, k);
+            sink.put(':');
+            if (pretty) sink.put(' ');
+            v.write_value(sink, pretty, indent + indent_size, indent_size, max_precision);
         }
+        if (pretty && !obj.empty()) { sink.put('\n'); sink.fill(' ', indent); }
+        sink.put('}');
     }
+}
 
-    static JSON parse_string(const std::string& s, size_t& idx) {
-        if(s[idx]!='"') throw JSONParseError("Expected string");
-        idx++;
-        std::string res;
-        while(idx<s.size()) {
-            char c = s[idx++];
-            if(c=='"') break;
-            if(c=='\\') {
-                if(idx>=s.size()) throw JSONParseError("Invalid escape: unexpected end of string");
-                char esc = s[idx++];
-                switch(esc){
-                    case '"': res+='"'; break;
-                    case '\\': res+='\\'; break;
-                    case '/': res+='/'; break;
-                    case 'b': res+='\b'; break;
-                    case 'f': res+='\f'; break;
-                    case 'n': res+='\n'; break;
-                    case 'r': res+='\r'; break;
-                    case 't': res+='\t'; break;
-                    case 'u': {
-                        if (idx + 4 > s.size()) throw JSONParseError("Invalid unicode escape");
-                        try {
-                            int codepoint = std::stoi(s.substr(idx, 4), nullptr, 16);
-                            idx += 4;
-                            
-                            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) { // High surrogate
-                                if (idx + 6 > s.size() || s.substr(idx, 2) != "\\u") {
-                                    throw JSONParseError("Invalid surrogate pair: high surrogate not followed by low surrogate escape");
-                                }
-                                int low_surrogate = std::stoi(s.substr(idx + 2, 4), nullptr, 16);
-                                idx += 6;
-                                
-                                if (low_surrogate < 0xDC00 || low_surrogate > 0xDFFF) {
-                                    throw JSONParseError("Invalid surrogate pair: high surrogate not followed by a low surrogate");
-                                }
-                                codepoint = 0x10000 + ((codepoint - 0xD800) << 10 | (low_surrogate - 0xDC00));
-                            } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
-                                throw JSONParseError("Invalid surrogate pair: low surrogate without high surrogate");
-                            }
-                            
-                            encode_utf8(res, codepoint);
-                        } catch (const std::exception&) {
-                            throw JSONParseError("Invalid unicode escape sequence");
-                        }
-                        break;
-                    }
-                    default: throw JSONParseError("Unknown escape sequence: \\" + std::string(1, esc));
-                }
-            } else if (c < 32) {
-                throw JSONParseError("Unescaped control character in string");
-            } else {
-                res+=c;
+template<typename Sink>
+void JSON::write_number(Sink& sink, double num, int max_precision) {
+    char buf[128];
+    int len;
+    if (num == static_cast<long long>(num) && num >= LLONG_MIN && num <= LLONG_MAX) {
+        len = std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(num));
+    } else {
+        len = std::snprintf(buf, sizeof(buf), "%.*g", max_precision, num);
+    }
+    sink.put(buf, static_cast<size_t>(std::min<int>(len, sizeof(buf) - 1)));
+}
+
+template<typename Sink>
+void JSON::write_string(Sink& sink, std::string_view str) {
+    sink.put('"');
+    write_escaped(sink, str);
+    sink.put('"');
+}
+
+template<typename Sink>
+void JSON::write_escaped(Sink& sink, std::string_view str) {
+    const char* data = str.data();
+    size_t run = 0;
+    for (size_t i = find_escape(data, str.size()); i < str.size(); i = run + find_escape(data + run, str.size() - run)) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        sink.put(data + run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"': sink.put("\\\"", 2); break;
+            case '\\': sink.put("\\\\", 2); break;
+            case '\b': sink.put("\\b", 2); break;
+            case '\f': sink.put("\\f", 2); break;
+            case '\n': sink.put("\\n", 2); break;
+            case '\r': sink.put("\\r", 2); break;
+            case '\t': sink.put("\\t", 2); break;
+            default: {
+                char esc[8];
+                std::snprintf(esc, sizeof(esc), "\\u%04x", c);
+                sink.put(esc, 6);
             }
         }
-        if (idx > s.size()) throw JSONParseError("Unterminated string");
-        return JSON(res);
     }
+    sink.put(data + run, str.size() - run);
+}
 
-    static JSON parse_array(const std::string& s, size_t& idx) {
-        if(s[idx]!='[') throw JSONParseError("Expected '['");
-        idx++;
-        std::vector<JSON> arr;
-        skip_ws(s, idx);
-        if(idx<s.size() && s[idx]==']') { idx++; return JSON(arr); }
-        while(true) {
-            arr.push_back(parse_value(s, idx));
-            skip_ws(s, idx);
-            if(idx>=s.size()) throw JSONParseError("Expected ',' or ']'");
-            if(s[idx]==',') { idx++; skip_ws(s, idx); continue; }
-            if(s[idx]==']') { idx++; break; }
-            throw JSONParseError(std::string("Unexpected character in array: ")+s[idx]);
+// ============ FROZEN DOCUMENTS ============
+// Read-only view over the output of JSON::freeze(). All links are offsets from
+// the start of the buffer, so the bytes can live at any address in any process.
+// Layout: 32-byte header ("EJF1", version, total size, root offset), then
+// 8-byte aligned records tagged with the JSONValue alternative index:
+//   null/bool: tag, value byte         number: tag, pad, double
+//   string:    tag, u32 length, bytes + NUL
+//   array:     tag, u32 count, u64 element offsets
+//   object:    tag, u32 count, (u64 key offset, u64 value offset) sorted by key
+class FrozenJSON {
+public:
+    FrozenJSON() = default;
+
+    // View of the root value. Throws if the buffer is not a frozen document.
+    FrozenJSON(const char* data, size_t size) {
+        if (size < header_size || std::memcmp(data, "EJF1", 4) != 0 || read<uint64_t>(data, 8) != size) {
+            throw JSONParseError("Not a frozen JSON document");
         }
-        return JSON(arr);
+        base = data;
+        offset = read<uint64_t>(data, 16);
     }
 
-    static JSON parse_object(const std::string& s, size_t& idx) {
-        if(s[idx]!='{') throw JSONParseError("Expected '{'");
-        idx++;
-        std::map<std::string, JSON> obj;
-        skip_ws(s, idx);
-        if(idx < s.size() && s[idx] == '}') { idx++; return JSON(obj); }
-        while(true) {
-            skip_ws(s, idx);
-            if(idx >= s.size() || s[idx] != '"') throw JSONParseError("Expected string key in object");
-            JSON key = parse_string(s, idx);
-            skip_ws(s, idx);
-            if(idx >= s.size() || s[idx] != ':') throw JSONParseError("Expected ':' after key in object");
-            idx++;
-            JSON val = parse_value(s, idx);
-            obj[key.as_string()] = val;
-            skip_ws(s, idx);
-            if(idx >= s.size()) throw JSONParseError("Expected ',' or '}' in object");
-            if(s[idx] == ',') { idx++; skip_ws(s, idx); continue; }
-            if(s[idx] == '}') { idx++; break; }
-            throw JSONParseError(std::string("Unexpected character in object: ") + s[idx]);
+    bool is_null() const { return !base || tag() == 0; }
+    bool is_bool() const { return base && tag() == 1; }
+    bool is_number() const { return base && tag() == 2; }
+    bool is_string() const { return base && tag() == 3; }
+    bool is_array() const { return base && tag() == 4; }
+    bool is_object() const { return base && tag() == 5; }
+
+    bool as_bool(bool default_val = false) const { return is_bool() ? base[offset + 1] != 0 : default_val; }
+    double as_number(double default_val = 0.0) const { return is_number() ? read<double>(base, offset + 8) : default_val; }
+    int as_int(int default_val = 0) const { return is_number() ? static_cast<int>(as_number()) : default_val; }
+    long long as_int64(long long default_val = 0) const { return is_number() ? static_cast<long long>(as_number()) : default_val; }
+
+    std::string_view as_string() const {
+        if (!is_string()) throw JSONParseError("Not a string");
+        return std::string_view(base + offset + 8, count());
+    }
+
+    size_t size() const {
+        return (is_array() || is_object() || is_string()) ? count() : 0;
+    }
+
+    // Array element; throws when out of bounds, like const JSON::operator[].
+    FrozenJSON operator[](size_t idx) const {
+        if (!is_array()) throw JSONParseError("Not an array");
+        if (idx >= count()) throw JSONParseError("Array index out of bounds");
+        return FrozenJSON(At(), base, read<uint64_t>(base, offset + 8 + idx * 8));
+    }
+
+    // Object member by binary search; throws when missing, like const JSON::operator[].
+    FrozenJSON operator[](std::string_view key) const {
+        FrozenJSON found = at(key);
+        if (!found.base) throw JSONParseError("Key not found: " + std::string(key));
+        return found;
+    }
+
+    // Object member, or a null view when missing.
+    FrozenJSON at(std::string_view key) const {
+        if (!is_object()) return FrozenJSON();
+        size_t lo = 0, hi = count();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            int cmp = key_at(mid).compare(key);
+            if (cmp == 0) return value_at(mid);
+            if (cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        return FrozenJSON();
+    }
+
+    bool contains(std::string_view key) const { return at(key).base != nullptr; }
+
+    // Object members by position, in key order.
+    std::string_view key_at(size_t idx) const {
+        return FrozenJSON(At(), base, read<uint64_t>(base, offset + 8 + idx * 16)).as_string();
+    }
+    FrozenJSON value_at(size_t idx) const {
+        return FrozenJSON(At(), base, read<uint64_t>(base, offset + 16 + idx * 16));
+    }
+
+    // Copies the viewed value back into a regular JSON tree.
+    JSON thaw() const {
+        if (is_bool()) return JSON(as_bool());
+        if (is_number()) return JSON(as_number());
+        if (is_string()) return JSON(std::string(as_string()));
+        if (is_array()) {
+            std::vector<JSON> arr;
+            arr.reserve(size());
+            for (size_t i = 0; i < size(); ++i) arr.push_back((*this)[i].thaw());
+            JSON result;
+            result.value = std::move(arr);
+            return result;
+        }
+        if (is_object()) {
+            std::map<std::string, JSON> obj;
+            for (size_t i = 0; i < size(); ++i) obj.emplace_hint(obj.end(), std::string(key_at(i)), value_at(i).thaw());
+            JSON result;
+            result.value = std::move(obj);
+            return result;
         }
-        return JSON(obj);
+        return JSON();
+    }
+
+    static constexpr size_t header_size = 32;
+
+private:
+    const char* base = nullptr;
+    uint64_t offset = 0;
+
+    struct At {};
+    FrozenJSON(At, const char* base, uint64_t offset) : base(base), offset(offset) {}
+
+    template<typename T>
+    static T read(const char* data, uint64_t at) {
+        T v;
+        std::memcpy(&v, data + at, sizeof(T));
+        return v;
     }
+    unsigned char tag() const { return static_cast<unsigned char>(base[offset]); }
+    size_t count() const { return read<uint32_t>(base, offset + 4); }
 };
 
-// ============ CONVENIENCE FUNCTIONS ============
-inline JSON object(std::initializer_list<std::pair<std::string, JSON>> list) {
-    return JSON(list);
-}
+#if defined(__unix__) || defined(__APPLE__)
+// ============ SHARED-MEMORY PUBLICATION ============
+// Publishes frozen documents to POSIX shared memory under a name such as
+// "/routing". Each publish writes a new data segment "<name>.<generation>" and
+// then bumps the generation counter in the control segment "<name>", so
+// readers in other processes switch to the new version atomically. Mappings a
+// reader already holds stay valid after the old segment is unlinked. Several
+// publishers may share a name: each claims its own generation, and a publish
+// that a newer generation overtakes is dropped.
+class SharedJSONPublisher {
+public:
+    explicit SharedJSONPublisher(const std::string& name);
+    ~SharedJSONPublisher();
+    SharedJSONPublisher(const SharedJSONPublisher&) = delete;
+    SharedJSONPublisher& operator=(const SharedJSONPublisher&) = delete;
 
-inline JSON array(std::initializer_list<JSON> list) {
-    return JSON(list);
-}
+    // Freezes doc into a new segment and makes it current unless a newer
+    // generation was published meanwhile. Returns the current generation.
+    uint64_t publish(const JSON& doc);
 
-// JSON literals support
-inline JSON operator""_json(const char* str, size_t) {
-    return JSON::parse(str);
-}
+    // Removes the control segment and the current data segment.
+    void unlink();
 
-} // namespace ejson
+private:
+    std::string name;
+    std::atomic<uint64_t>* generation = nullptr;
+};
 
-// ============ CONVENIENCE MACROS ============
-#define JSON_OBJECT(...) ejson::object({__VA_ARGS__})
-#define JSON_ARRAY(...) ejson::array({__VA_ARGS__})
+// Zero-copy reader for documents published by SharedJSONPublisher.
+class SharedJSONReader {
+public:
+    explicit SharedJSONReader(const std::string& name);
+    ~SharedJSONReader();
+    SharedJSONReader(const SharedJSONReader&) = delete;
+    SharedJSONReader& operator=(const SharedJSONReader&) = delete;
+
+    // Maps the newest generation if it changed. Returns true when it switched.
+    // Views obtained from root() before a switch become invalid.
+    bool refresh();
+
+    FrozenJSON root() const { return FrozenJSON(data, size); }
+    uint64_t generation() const { return mapped_generation; }
+
+private:
+    std::string name;
+    const std::atomic<uint64_t>* control = nullptr;
+    const char* data = nullptr;
+    size_t size = 0;
+    uint64_t mapped_generation = 0;
+};
+#endif
+
+// ============ ARRAY FILE INDEX ============
+// Random access into a file holding one large top-level JSON array. A single
+// scan records the byte offset of every stride-th element in a sidecar file
+// ("<path>.idx"); at(i) then seeks to the nearest sample and parses only the
+// requested element. The sidecar is rebuilt when the file's size or
+// modification time changes.
+class JSONArrayFile {
+public:
+    // Loads a matching sidecar index, or scans the file and tries to save one.
+    explicit JSONArrayFile(const std::string& path, size_t stride = 64);
+
+    // Scans path and writes its sidecar index, throwing if it cannot be saved.
+    static void build_index(const std::string& path, size_t stride = 64);
+
+    static std::string index_path(const std::string& path) { return path + ".idx"; }
+
+    size_t size() const { return static_cast<size_t>(count); }
+
+    // Parses element i. Throws when out of bounds.
+    JSON at(size_t i) const;
+    JSON operator[](size_t i) const { return at(i); }
+
+    // Parses elements [begin, end), clamped to size().
+    std::vector<JSON> slice(size_t begin, size_t end) const;
+
+private:
+    std::string path;
+    uint64_t stride = 64;
+    uint64_t file_size = 0;
+    uint64_t file_mtime = 0;
+    uint64_t count = 0;
+    std::vector<uint64_t> samples;
+
+    JSONArrayFile() = default;
+    uint64_t modification_time() const;
+    void build();
+    bool load();
+    bool save() const;
+};
+
+// ============ TEXT FORMATTING ============
+// Re-format JSON text without building a tree: key order, number lexemes and
+// string escapes are copied through exactly as written. Only string
+// termination and bracket balance are checked; run JSON::parse for full validation.
+
+// Strips all insignificant whitespace.
+EJSON_INLINE std::string minify(std::string_view text);
+
+// Pretty-prints with the same layout as dump_pretty(indent_size).
+EJSON_INLINE std::string reformat(std::string_view text, int indent_size = 2);
+
+// ============ OUTPUT TEMPLATES ============
+// A JSON skeleton with $name placeholders in value positions, e.g.
+//   Template user(R"({"id": $id, "name": $name, "tags": $tags})");
+//   std::string s = user.render(42, name, tags);
+// The constant text is minified once at construction; render() only formats
+// the arguments (bool, integers, floating point, strings, nullptr or JSON)
+// between the pre-serialized segments. Arguments are positional, one per
+// distinct placeholder in order of first appearance.
+class Template {
+public:
+    explicit Template(std::string_view skeleton, int max_precision = 6);
+
+    // Distinct placeholder names in argument order.
+    const std::vector<std::string>& placeholders() const { return names; }
+
+    template<typename... Args>
+    std::string render(const Args&... args) const {
+        std::string out;
+        render_into(out, args...);
+        return out;
+    }
+
+    // Appends the rendered text to out, so a buffer can be reused across calls.
+    template<typename... Args>
+    void render_into(std::string& out, const Args&... args) const {
+        if (sizeof...(Args) != names.size()) throw JSONParseError("Template expects " + std::to_string(names.size()) + " arguments");
+        const Arg table[] = {Arg{&args, &write_arg<Args>}..., Arg{nullptr, nullptr}};
+        emit(out, table);
+    }
+
+    // Renders with values looked up by placeholder name; throws if one is missing.
+    std::string render(const std::map<std::string, JSON>& values) const;
+
+private:
+    struct Arg {
+        const void* value;
+        void (*write)(JSON::StringSink&, const void*, int);
+    };
+
+    std::vector<std::string> segments;  // constant text around each placeholder use
+    std::vector<size_t> uses;           // argument index of each placeholder use
+    std::vector<std::string> names;
+    int max_precision;
+
+    void emit(std::string& out, const Arg* args) const {
+        JSON::StringSink sink{out};
+        for (size_t i = 0; i < uses.size(); ++i) {
+            out += segments[i];
+            const Arg& arg = args[uses[i]];
+            arg.write(sink, arg.value, max_precision);
+        }
+        out += segments.back();
+    }
+
+    template<typename T>
+    static void write_arg(JSON::StringSink& sink, const void* ptr, int precision) {
+        const T& v = *static_cast<const T*>(ptr);
+        if constexpr (std::is_same_v<T, bool>) {
+            if (v) sink.put("true", 4);
+            else sink.put("false", 5);
+        } else if constexpr (std::is_integral_v<T>) {
+            char buf[32];
+            int len = std::is_signed_v<T> ? std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(v))
+                                          : std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(v));
+            sink.put(buf, static_cast<size_t>(len));
+        } else if constexpr (std::is_floating_point_v<T>) {
+            JSON::write_number(sink, static_cast<double>(v), precision);
+        } else if constexpr (std::is_same_v<T, std::nullptr_t>) {
+            sink.put("null", 4);
+        } else if constexpr (std::is_same_v<T, JSON>) {
+            v.write_value(sink, false, 0, 0, precision);
+        } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            JSON::write_string(sink, std::string_view(v));
+        } else {
+            static_assert(std::is_same_v<T, void>, "Unsupported template argument type");
+        }
+    }
+};
+
+// ============ SHAPE PROFILING ============
+// Aggregates structural statistics over a corpus of documents: nesting depth,
+// container sizes, key frequencies, string lengths, number kinds, repeated
+// short string values and the value types seen at each path. report()
+// summarizes them as JSON, including suggested ParseOptions.
+class ShapeProfile {
+public:
+    // Power-of-two histogram: bucket 0 counts zeros, bucket b counts [2^(b-1), 2^b).
+    struct Histogram {
+        std::array<size_t, 65> buckets{};
+        size_t count = 0;
+        size_t max = 0;
+        double total = 0;
+
+        void add(size_t n);
+        void merge(const Histogram& other);
+        // Upper bound of the bucket holding the p-th fraction of samples.
+        size_t percentile(double p) const;
+        JSON to_json() const;
+    };
+
+    void add(const JSON& doc);
+    // Profiles one document per file, gzip-aware like JSON::from_file().
+    void add_file(const std::string& path);
+    // Profiles one document per non-empty line.
+    void add_ndjson(const std::string& path);
+    void merge(const ShapeProfile& other);
+
+    // Profiles files on several threads and merges the results.
+    static ShapeProfile profile_files(const std::vector<std::string>& paths, bool ndjson = false, unsigned threads = 0);
+
+    size_t documents() const { return docs; }
+    ParseOptions suggested_parse_options() const;
+    JSON report() const;
+
+    // Bounds on distinct short string values and paths tracked per profile.
+    static constexpr size_t max_tracked_values = 4096;
+    static constexpr size_t max_tracked_paths = 4096;
+    static constexpr size_t max_value_length = 32;
+
+private:
+    size_t docs = 0;
+    size_t nulls = 0, bools = 0, integers = 0, fractions = 0, strings = 0, arrays = 0, objects = 0;
+    Histogram depths, array_sizes, object_sizes, string_lengths;
+    std::map<std::string, size_t> key_counts;
+    std::map<std::string, size_t> value_counts;  // strings up to max_value_length
+    std::map<std::string, unsigned> path_types;  // bit per JSONValue alternative
+
+    void walk(const JSON& node, size_t depth, std::string& path, size_t& max_depth);
+};
+
+// ============ ARRAY EDITING ============
+// Queue and sliding-window editing of one large array. Removed front slots
+// stay at the start of the array's vector as a gap that push_front refills,
+// so front operations are amortized O(1) and insert/erase move whichever
+// side of the index is shorter. The gap is closed once it outgrows the live
+// elements, on commit() and on destruction; until then, access the array
+// only through the editor.
+class ArrayEditor {
+public:
+    // A null value becomes an empty array; other non-arrays throw.
+    explicit ArrayEditor(JSON& array);
+    ~ArrayEditor() { commit(); }
+
+    ArrayEditor(const ArrayEditor&) = delete;
+    ArrayEditor& operator=(const ArrayEditor&) = delete;
+
+    size_t size() const { return arr->size() - head; }
+    bool empty() const { return arr->size() == head; }
+
+    JSON& operator[](size_t idx);
+    const JSON& operator[](size_t idx) const;
+    JSON& front() { return (*this)[0]; }
+    JSON& back() { return (*this)[size() - 1]; }
+
+    std::vector<JSON>::iterator begin() { return arr->begin() + head; }
+    std::vector<JSON>::iterator end() { return arr->end(); }
+    std::vector<JSON>::const_iterator begin() const { return arr->cbegin() + head; }
+    std::vector<JSON>::const_iterator end() const { return arr->cend(); }
+
+    void push_back(const JSON& item) { arr->push_back(item); }
+    void push_front(const JSON& item) { insert(0, item); }
+    JSON pop_front();
+    JSON pop_back();
+    void insert(size_t index, const JSON& item);
+    void erase(size_t index);
+
+    // Closes the gap so the array holds exactly its elements again.
+    void commit();
+
+    static constexpr size_t min_gap = 16;
+
+private:
+    std::vector<JSON>* arr;
+    size_t head = 0;  // removed slots at the front of *arr
+
+    void reclaim();
+};
+
+// ============ INCREMENTAL DUMP ============
+// Owns a document and caches the compact bytes of its containers of at least
+// min_bytes between dumps, so a re-dump only re-serializes the paths that
+// were edited. Changes go through edit() or set_path(), which drop the cached
+// bytes of the target, its ancestors and everything below it. A reference
+// returned by edit() may be changed freely until the next edit() or dump().
+class CachedDocument {
+public:
+    CachedDocument() = default;
+    explicit CachedDocument(JSON doc) : doc(std::move(doc)) {}
+
+    const JSON& document() const { return doc; }
+
+    // Returns the value at path (JSON::set_path syntax), creating it as
+    // set_path would.
+    JSON& edit(const std::string& path);
+    void set_path(const std::string& path, const JSON& val) { edit(path) = val; }
+
+    // Same text as document().dump(false, 0, 2, max_precision).
+    std::string dump(int max_precision = 6);
+
+    static constexpr size_t min_bytes = 64;
+
+private:
+    JSON doc;
+    // Keyed by path, one prefix-closed step per level ("k<len>:<key>" or
+    // "i<index>;"), so a subtree is a contiguous key range.
+    std::map<std::string, std::string> cache;
+    int precision = 6;
+
+    void write(const JSON& node, std::string& key, std::string& out);
+};
+
+// ============ CONCURRENT DOCUMENTS ============
+// A shared top-level object whose members can be read and updated from many
+// threads. Each top-level key owns an immutable snapshot that is replaced
+// atomically on write (copy-on-write), so readers never wait for writers and
+// writers to different keys run in parallel. Keys are spread over lock
+// stripes that are only locked exclusively to add or remove keys.
+// Paths use the JSON::set_path syntax and start with the top-level key,
+// e.g. "users.alice.score" or "queues.jobs[0]".
+class ConcurrentDocument {
+public:
+    explicit ConcurrentDocument(size_t stripes = 64);
+    // Throws unless initial is an object.
+    explicit ConcurrentDocument(const JSON& initial, size_t stripes = 64);
+
+    ConcurrentDocument(const ConcurrentDocument&) = delete;
+    ConcurrentDocument& operator=(const ConcurrentDocument&) = delete;
+
+    // Immutable snapshot of a top-level member, or nullptr if missing.
+    std::shared_ptr<const JSON> snapshot(const std::string& key) const;
+
+    // Copy of the value at path; null if missing.
+    JSON get_path(const std::string& path) const;
+
+    void set_path(const std::string& path, const JSON& val);
+
+    // Runs fn on a private copy of the value at path (null if missing) and
+    // publishes the result. Updates to the same top-level key are serialized,
+    // so read-modify-write sequences are atomic.
+    void update_path(const std::string& path, const std::function<void(JSON&)>& fn);
+
+    bool erase(const std::string& key);
+    bool contains(const std::string& key) const { return snapshot(key) != nullptr; }
+    size_t size() const;
+
+    // Copy of the whole document. Each member is consistent on its own; the
+    // document as a whole is not captured at a single instant.
+    JSON to_json() const;
+
+private:
+    struct Slot {
+        std::mutex write;
+        std::shared_ptr<const JSON> value;  // accessed with std::atomic_load/atomic_store
+        bool erased = false;                // set by erase() under write once unlinked
+    };
+
+    struct Stripe {
+        mutable std::shared_mutex lock;
+        std::unordered_map<std::string, std::shared_ptr<Slot>> slots;
+    };
+
+    std::vector<Stripe> stripes;
+
+    Stripe& stripe_for(const std::string& key) const;
+    std::shared_ptr<Slot> find_slot(const std::string& key) const;
+    std::shared_ptr<Slot> slot_for(const std::string& key);
+    // Splits "key.rest" or "key[0].rest" into the top-level key and the remainder.
+    static std::pair<std::string, std::string> split_path(const std::string& path);
+};
+
+// ============ INDEXED COLLECTIONS ============
+// Owns many small documents in frozen form and keeps secondary indexes on
+// declared paths up to date across insert, update and remove. Paths use the
+// at_path syntax plus "[*]" for every array element, e.g. "user.id" or
+// "tags[*]". Hash indexes answer find(); ordered indexes also answer
+// range(). Queries on unindexed paths and arbitrary predicates fall back to
+// a parallel scan.
+class Collection {
+public:
+    using Id = uint64_t;
+    enum class IndexKind { Hash, Ordered };
+
+    // Declares an index and fills it from the documents already stored.
+    void create_index(const std::string& path, IndexKind kind = IndexKind::Hash);
+    bool drop_index(const std::string& path);
+
+    Id insert(const JSON& doc);
+    // Throws if id is not stored.
+    void update(Id id, const JSON& doc);
+    bool remove(Id id);
+
+    bool contains(Id id) const { return id < docs.size() && !docs[id].empty(); }
+    size_t size() const { return live; }
+
+    // Copy of a document. Throws if id is not stored.
+    JSON get(Id id) const;
+    // Zero-copy view, valid until the document is updated or removed.
+    FrozenJSON view(Id id) const;
+
+    // Ids of documents with a value at path equal to value, in id order.
+    std::vector<Id> find(const std::string& path, const JSON& value) const;
+    // Ids of documents with a value at path in [low, high] (JSON operator< order).
+    std::vector<Id> range(const std::string& path, const JSON& low, const JSON& high) const;
+    // Ids of documents matching pred, evaluated on several threads.
+    std::vector<Id> scan(const std::function<bool(const FrozenJSON&)>& pred, unsigned threads = 0) const;
+
+private:
+    struct Step {
+        std::string key;
+        size_t index = 0;
+        enum { Key, Index, Each } kind = Key;
+    };
+
+    struct Index {
+        IndexKind kind;
+        std::vector<Step> steps;
+        std::unordered_map<std::string, std::set<Id>> hashed;  // keyed by hash_key()
+        std::map<JSON, std::set<Id>> ordered;
+    };
+
+    std::vector<std::string> docs;  // frozen bytes by id; empty once removed
+    size_t live = 0;
+    std::map<std::string, Index> indexes;
+
+    // Minified value with numbers at 17 significant digits, which round-trips
+    // every double, so distinct values never share a key.
+    static std::string hash_key(const JSON& value) { return value.dump(false, 0, 2, 17); }
+    static std::vector<Step> parse_steps(const std::string& path);
+    template<typename Node>
+    static void collect(const Node& node, const std::vector<Step>& steps, size_t i, std::vector<JSON>& out);
+    void index_document(Index& index, Id id, const FrozenJSON& doc, bool add);
+    void index_document(Id id, bool add);
+};
+
+// ============ DELTA LOG STORE ============
+// Persists successive versions of one document as a snapshot file
+// ("<base>.snapshot") plus an append-only log of patches ("<base>.log"), so a
+// save writes only what changed. Each log line is one version:
+//   {"v":7,"ops":[{"op":"set","path":["users","alice","score"],"value":3},
+//                 {"op":"remove","path":["sessions",0]}]}
+// Paths are arrays of object keys and array indexes. Once the log grows past
+// checkpoint_bytes the store writes a fresh snapshot and starts a new log.
+// Opening replays the log over the snapshot; a torn final line left by a
+// crash is dropped. Numbers are written with 17 significant digits so they
+// read back exactly.
+class DeltaStore {
+public:
+    struct Options {
+        bool sync = true;                      // fsync log appends and snapshots
+        size_t checkpoint_bytes = 64u << 20;   // log size that triggers a checkpoint
+    };
+
+    explicit DeltaStore(const std::string& base_path) : DeltaStore(base_path, Options()) {}
+    DeltaStore(const std::string& base_path, const Options& options);
+    ~DeltaStore();
+
+    DeltaStore(const DeltaStore&) = delete;
+    DeltaStore& operator=(const DeltaStore&) = delete;
+
+    const JSON& document() const { return doc; }
+    uint64_t version() const { return current_version; }
+
+    // Appends the difference between the stored document and next as a new
+    // version. Returns the new version, or the current one if nothing changed.
+    uint64_t save(const JSON& next);
+
+    // Appends a single change without diffing. Path segments are keys
+    // (strings) and array indexes (numbers).
+    uint64_t set(const std::vector<JSON>& path, const JSON& value);
+    uint64_t remove(const std::vector<JSON>& path);
+
+    // Writes the current document as the snapshot and truncates the log.
+    void checkpoint();
+
+    size_t log_bytes() const { return log_size; }
+
+    // Patch operations between two documents, in the log's "ops" format.
+    static JSON diff(const JSON& from, const JSON& to);
+    // Applies "ops" produced by diff() to doc.
+    static void apply(JSON& doc, const JSON& ops);
+
+private:
+    std::string base;
+    Options options;
+    JSON doc;
+    uint64_t current_version = 0;
+    size_t log_size = 0;
+    std::FILE* log = nullptr;
+
+    void recover();
+    // Writes ops to the log as the next version. Callers update doc only
+    // after this succeeds, then call checkpoint_if_due().
+    uint64_t append(const JSON& ops);
+    void checkpoint_if_due();
+    void open_log(const char* mode);
+    static void diff_into(const JSON& from, const JSON& to, std::vector<JSON>& path, JSON& ops);
+    // Throws unless apply() can make this change to doc.
+    static void check_path(const JSON& doc, const std::vector<JSON>& path, bool is_remove);
+    static bool sync_file(std::FILE* file);
+    void sync_directory() const;
+};
+
+// ============ CONVENIENCE FUNCTIONS ============
+inline JSON object(std::initializer_list<std::pair<std::string, JSON>> list) {
+    return JSON(list);
+}
+
+inline JSON array(std::initializer_list<JSON> list) {
+    return JSON(list);
+}
+
+// JSON literals support
+inline JSON operator""_json(const char* str, size_t) {
+    return JSON::parse(str);
+}
+
+#if defined(EJSON_COMPILED) && !defined(EJSON_IMPLEMENTATION)
+// Common conversions are instantiated once, in the implementation file.
+extern template bool JSON::get<bool>() const;
+extern template int JSON::get<int>() const;
+extern template long long JSON::get<long long>() const;
+extern template float JSON::get<float>() const;
+extern template double JSON::get<double>() const;
+extern template std::string JSON::get<std::string>() const;
+extern template bool JSON::get_or<bool>(const bool&) const;
+extern template int JSON::get_or<int>(const int&) const;
+extern template long long JSON::get_or<long long>(const long long&) const;
+extern template float JSON::get_or<float>(const float&) const;
+extern template double JSON::get_or<double>(const double&) const;
+extern template std::string JSON::get_or<std::string>(const std::string&) const;
+#endif
+
+} // namespace ejson
+
+// ============ CONVENIENCE MACROS ============
+#define JSON_OBJECT(...) ejson::object({__VA_ARGS__})
+#define JSON_ARRAY(...) ejson::array({__VA_ARGS__})
+
+// ============ IMPLEMENTATION ============
+#if !defined(EJSON_COMPILED) || defined(EJSON_IMPLEMENTATION)
+namespace ejson {
+
+// ============ BASE64 ============
+namespace detail {
+    inline constexpr char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    // Decode table values: 0-63 sextet, 64 padding, 65 whitespace, 255 invalid.
+    struct Base64Table {
+        unsigned char v[256];
+        constexpr Base64Table() : v() {
+            for (int i = 0; i < 256; ++i) v[i] = 255;
+            for (int i = 0; i < 64; ++i) v[static_cast<unsigned char>(base64_alphabet[i])] = static_cast<unsigned char>(i);
+            v[static_cast<unsigned char>('=')] = 64;
+            v[static_cast<unsigned char>(' ')] = v[static_cast<unsigned char>('\n')] = 65;
+            v[static_cast<unsigned char>('\r')] = v[static_cast<unsigned char>('\t')] = 65;
+        }
+    };
+    inline constexpr Base64Table base64_table{};
+}
+
+EJSON_INLINE std::string base64_encode(const unsigned char* data, size_t len) {
+    std::string out((len + 2) / 3 * 4, '=');
+    char* o = &out[0];
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3, o += 4) {
+        unsigned n = (unsigned(data[i]) << 16) | (unsigned(data[i + 1]) << 8) | data[i + 2];
+        o[0] = detail::base64_alphabet[n >> 18];
+        o[1] = detail::base64_alphabet[(n >> 12) & 63];
+        o[2] = detail::base64_alphabet[(n >> 6) & 63];
+        o[3] = detail::base64_alphabet[n & 63];
+    }
+    if (i < len) {
+        unsigned n = unsigned(data[i]) << 16;
+        if (i + 1 < len) n |= unsigned(data[i + 1]) << 8;
+        o[0] = detail::base64_alphabet[n >> 18];
+        o[1] = detail::base64_alphabet[(n >> 12) & 63];
+        if (i + 1 < len) o[2] = detail::base64_alphabet[(n >> 6) & 63];
+    }
+    return out;
+}
+
+EJSON_INLINE std::string base64_encode(const std::vector<unsigned char>& bytes) {
+    return base64_encode(bytes.data(), bytes.size());
+}
+
+EJSON_INLINE void base64_decode(const char* data, size_t len, std::vector<unsigned char>& out) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    const auto& t = detail::base64_table.v;
+    out.reserve(out.size() + len / 4 * 3);
+    size_t i = 0;
+    unsigned quad = 0;
+    int count = 0, padding = 0;
+    while (i < len) {
+        // Fast path: whole groups of four alphabet characters.
+        if (count == 0) {
+            while (i + 4 <= len) {
+                unsigned a = t[in[i]], b = t[in[i + 1]], c = t[in[i + 2]], d = t[in[i + 3]];
+                if ((a | b | c | d) >= 64) break;
+                unsigned n = (a << 18) | (b << 12) | (c << 6) | d;
+                out.push_back(static_cast<unsigned char>(n >> 16));
+                out.push_back(static_cast<unsigned char>(n >> 8));
+                out.push_back(static_cast<unsigned char>(n));
+                i += 4;
+            }
+            if (i >= len) break;
+        }
+        unsigned v = t[in[i++]];
+        if (v == 65) continue;
+        if (v == 255) throw JSONParseError("Invalid base64 character at offset " + std::to_string(i - 1));
+        if (v == 64) {
+            if (count < 2) throw JSONParseError("Misplaced base64 padding at offset " + std::to_string(i - 1));
+            padding++;
+            v = 0;
+        } else if (padding) {
+            throw JSONParseError("Base64 data after padding at offset " + std::to_string(i - 1));
+        }
+        quad = (quad << 6) | v;
+        if (++count == 4) {
+            out.push_back(static_cast<unsigned char>(quad >> 16));
+            if (padding < 2) out.push_back(static_cast<unsigned char>(quad >> 8));
+            if (padding < 1) out.push_back(static_cast<unsigned char>(quad));
+            quad = 0;
+            count = 0;
+            if (padding) {
+                for (; i < len; ++i) {
+                    if (t[in[i]] != 65) throw JSONParseError("Base64 data after padding at offset " + std::to_string(i));
+                }
+            }
+        }
+    }
+    if (count == 1) throw JSONParseError("Truncated base64 input");
+    if (count > 1) {
+        // Padding characters in an unfinished group carry no data.
+        quad <<= 6 * (4 - count);
+        out.push_back(static_cast<unsigned char>(quad >> 16));
+        if (count - padding == 3) out.push_back(static_cast<unsigned char>(quad >> 8));
+    }
+}
+
+// ============ GZIP / DEFLATE DECODING ============
+// Minimal RFC 1951/1952 decoder used by from_file() for .gz inputs. Compressed
+// bytes are read from the stream in fixed-size chunks and inflated straight
+// into the destination string, which doubles as the LZ77 window.
+namespace detail {
+    EJSON_INLINE uint32_t crc32(const char* data, size_t len) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < len; ++i) crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
+
+    EJSON_INLINE bool is_gzip(std::istream& in) {
+        char magic[2] = {0, 0};
+        in.read(magic, 2);
+        bool gzip = in.gcount() == 2 && static_cast<unsigned char>(magic[0]) == 0x1F && static_cast<unsigned char>(magic[1]) == 0x8B;
+        in.clear();
+        in.seekg(0);
+        return gzip;
+    }
+
+    class Inflater {
+    public:
+        Inflater(std::istream& in, std::string& out, size_t max_size) : in(in), out(out), max_size(max_size) {}
+
+        // Decodes every gzip member in the stream, appending the payload to out.
+        void gunzip() {
+            do {
+                size_t member_start = out.size();
+                read_gzip_header();
+                inflate();
+                bit_buf >>= bit_count % 8;
+                bit_count -= bit_count % 8;
+                uint32_t crc = read_u32();
+                uint32_t size = read_u32();
+                if (crc != crc32(out.data() + member_start, out.size() - member_start)) throw JSONParseError("gzip CRC mismatch");
+                if (size != static_cast<uint32_t>(out.size() - member_start)) throw JSONParseError("gzip size mismatch");
+            } while (next_member());
+        }
+
+    private:
+        struct Huffman {
+            uint16_t count[16];
+            uint16_t symbol[288];
+            uint16_t fast[1 << 9];   // (length << 9) | symbol for codes up to 9 bits, 0 otherwise
+        };
+
+        std::istream& in;
+        std::string& out;
+        size_t max_size;
+        char chunk[1 << 16];
+        size_t chunk_pos = 0, chunk_len = 0;
+        uint64_t bit_buf = 0;
+        int bit_count = 0;
+
+        bool fill_chunk() {
+            if (chunk_pos < chunk_len) return true;
+            in.read(chunk, sizeof(chunk));
+            chunk_len = static_cast<size_t>(in.gcount());
+            chunk_pos = 0;
+            return chunk_len > 0;
+        }
+
+        void reserve_output(size_t n) {
+            if (n > max_size - std::min(out.size(), max_size)) throw JSONParseError("gzip payload exceeds decompressed size limit");
+        }
+
+        int next_byte() {
+            if (!fill_chunk()) return -1;
+            return static_cast<unsigned char>(chunk[chunk_pos++]);
+        }
+
+        void refill() {
+            while (bit_count <= 56) {
+                int b = next_byte();
+                if (b < 0) break;
+                bit_buf |= static_cast<uint64_t>(b) << bit_count;
+                bit_count += 8;
+            }
+        }
+
+        uint32_t bits(int need) {
+            if (bit_count < need) refill();
+            if (bit_count < need) throw JSONParseError("Unexpected end of gzip data");
+            uint32_t val = static_cast<uint32_t>(bit_buf & ((1ull << need) - 1));
+            bit_buf >>= need;
+            bit_count -= need;
+            return val;
+        }
+
+        uint32_t read_u8() { return bits(8); }
+        uint32_t read_u16() { uint32_t lo = read_u8(); return lo | (read_u8() << 8); }
+        uint32_t read_u32() { uint32_t lo = read_u16(); return lo | (read_u16() << 16); }
+
+        bool next_member() {
+            refill();
+            while (bit_count >= 8 && (bit_buf & 0xFF) == 0) { bit_buf >>= 8; bit_count -= 8; refill(); }
+            if (bit_count == 0) return false;
+            if (bit_count < 16 || (bit_buf & 0xFFFF) != 0x8B1F) throw JSONParseError("Trailing garbage after gzip data");
+            return true;
+        }
+
+        void read_gzip_header() {
+            if (read_u16() != 0x8B1F) throw JSONParseError("Not a gzip stream");
+            if (read_u8() != 8) throw JSONParseError("Unsupported gzip compression method");
+            uint32_t flags = read_u8();
+            for (int i = 0; i < 6; ++i) read_u8();   // mtime, xfl, os
+            if (flags & 4) { uint32_t extra = read_u16(); while (extra--) read_u8(); }
+            if (flags & 8) while (read_u8() != 0) {}
+            if (flags & 16) while (read_u8() != 0) {}
+            if (flags & 2) read_u16();
+        }
+
+        static void build(Huffman& h, const uint8_t* lengths, int n) {
+            std::fill(std::begin(h.count), std::end(h.count), uint16_t(0));
+            std::fill(std::begin(h.fast), std::end(h.fast), uint16_t(0));
+            for (int i = 0; i < n; ++i) h.count[lengths[i]]++;
+            h.count[0] = 0;
+            int left = 1;
+            for (int len = 1; len < 16; ++len) {
+                left = (left << 1) - h.count[len];
+                if (left < 0) throw JSONParseError("Invalid Huffman code lengths");
+            }
+            uint16_t offset[16] = {0};
+            int next_code[16] = {0};
+            for (int len = 1, code = 0; len < 16; ++len) {
+                if (len > 1) offset[len] = static_cast<uint16_t>(offset[len - 1] + h.count[len - 1]);
+                code = (code + h.count[len - 1]) << 1;
+                next_code[len] = code;
+            }
+            for (int sym = 0; sym < n; ++sym) {
+                int len = lengths[sym];
+                if (len == 0) continue;
+                h.symbol[offset[len]++] = static_cast<uint16_t>(sym);
+                int c = next_code[len]++;
+                if (len > 9) continue;
+                int reversed = 0;
+                for (int k = 0; k < len; ++k) reversed |= ((c >> k) & 1) << (len - 1 - k);
+                for (int r = reversed; r < (1 << 9); r += 1 << len) h.fast[r] = static_cast<uint16_t>((len << 9) | sym);
+            }
+        }
+
+        int decode(const Huffman& h) {
+            if (bit_count < 15) refill();
+            uint16_t entry = h.fast[bit_buf & 511];
+            int len = entry >> 9;
+            if (len != 0 && len <= bit_count) {
+                bit_buf >>= len;
+                bit_count -= len;
+                return entry & 511;
+            }
+            int code = 0, first = 0, index = 0;
+            for (len = 1; len < 16 && len <= bit_count; ++len) {
+                code |= static_cast<int>((bit_buf >> (len - 1)) & 1);
+                int count = h.count[len];
+                if (code - first < count) {
+                    bit_buf >>= len;
+                    bit_count -= len;
+                    return h.symbol[index + code - first];
+                }
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+            throw JSONParseError("Invalid or truncated deflate data");
+        }
+
+        void inflate() {
+            bool last = false;
+            while (!last) {
+                last = bits(1) != 0;
+                uint32_t type = bits(2);
+                if (type == 0) stored_block();
+                else if (type == 1) fixed_block();
+                else if (type == 2) dynamic_block();
+                else throw JSONParseError("Invalid deflate block type");
+            }
+        }
+
+        void stored_block() {
+            bit_buf >>= bit_count % 8;
+            bit_count -= bit_count % 8;
+            uint32_t len = read_u16();
+            if ((~read_u16() & 0xFFFF) != len) throw JSONParseError("Corrupt stored deflate block");
+            reserve_output(len);
+            while (len > 0 && bit_count >= 8) { out += static_cast<char>(read_u8()); len--; }
+            while (len > 0) {
+                if (!fill_chunk()) throw JSONParseError("Unexpected end of gzip data");
+                size_t take = std::min<size_t>(len, chunk_len - chunk_pos);
+                out.append(chunk + chunk_pos, take);
+                chunk_pos += take;
+                len -= static_cast<uint32_t>(take);
+            }
+        }
+
+        void fixed_block() {
+            static const auto tables = [] {
+                std::pair<Huffman, Huffman> t;
+                uint8_t lengths[288];
+                for (int i = 0; i < 288; ++i) lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+                build(t.first, lengths, 288);
+                std::fill(lengths, lengths + 30, uint8_t(5));
+                build(t.second, lengths, 30);
+                return t;
+            }();
+            codes(tables.first, tables.second);
+        }
+
+        void dynamic_block() {
+            static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            int nlen = static_cast<int>(bits(5)) + 257;
+            int ndist = static_cast<int>(bits(5)) + 1;
+            int ncode = static_cast<int>(bits(4)) + 4;
+            if (nlen > 286 || ndist > 30) throw JSONParseError("Invalid deflate code counts");
+            uint8_t lengths[320] = {0};
+            for (int i = 0; i < ncode; ++i) lengths[order[i]] = static_cast<uint8_t>(bits(3));
+            Huffman lencode, distcode;
+            build(lencode, lengths, 19);
+            for (int i = 0; i < nlen + ndist;) {
+                int sym = decode(lencode);
+                if (sym < 16) { lengths[i++] = static_cast<uint8_t>(sym); continue; }
+                uint8_t repeat_len = 0;
+                int repeat;
+                if (sym == 16) {
+                    if (i == 0) throw JSONParseError("Invalid deflate length repeat");
+                    repeat_len = lengths[i - 1];
+                    repeat = 3 + static_cast<int>(bits(2));
+                } else if (sym == 17) {
+                    repeat = 3 + static_cast<int>(bits(3));
+                } else {
+                    repeat = 11 + static_cast<int>(bits(7));
+                }
+                if (i + repeat > nlen + ndist) throw JSONParseError("Invalid deflate length repeat");
+                while (repeat--) lengths[i++] = repeat_len;
+            }
+            if (lengths[256] == 0) throw JSONParseError("Missing deflate end-of-block code");
+            build(lencode, lengths, nlen);
+            build(distcode, lengths + nlen, ndist);
+            codes(lencode, distcode);
+        }
+
+        void codes(const Huffman& lencode, const Huffman& distcode) {
+            static const uint16_t len_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+            static const uint8_t len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+            static const uint16_t dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+            static const uint8_t dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+            while (true) {
+                int sym = decode(lencode);
+                if (sym < 256) {
+                    reserve_output(1);
+                    out += static_cast<char>(sym);
+                    continue;
+                }
+                if (sym == 256) return;
+                sym -= 257;
+                if (sym >= 29) throw JSONParseError("Invalid deflate length code");
+                size_t len = len_base[sym] + bits(len_extra[sym]);
+                int dsym = decode(distcode);
+                if (dsym >= 30) throw JSONParseError("Invalid deflate distance code");
+                size_t dist = dist_base[dsym] + bits(dist_extra[dsym]);
+                if (dist > out.size()) throw JSONParseError("Deflate distance too far back");
+                reserve_output(len);
+                size_t from = out.size() - dist;
+                size_t to = out.size();
+                out.resize(to + len);
+                char* p = &out[0];
+                for (size_t k = 0; k < len; ++k) p[to + k] = p[from + k];
+            }
+        }
+    };
+
+    EJSON_INLINE void gunzip(std::istream& in, std::string& out, size_t max_size) {
+        Inflater(in, out, max_size).gunzip();
+    }
+}
+
+EJSON_INLINE JSON JSON::at_path(const std::string& path) const {
+    const JSON* current = this;
+    size_t i = 0;
+    while(i < path.size()) {
+        if(path[i] == '.') { i++; continue; }
+        if(std::isalpha(path[i]) || path[i]=='_') {
+            size_t start = i;
+            while(i < path.size() && (std::isalnum(path[i]) || path[i]=='_')) i++;
+            std::string key = path.substr(start,i-start);
+            if(!current->is_object()) return JSON();
+            const auto& obj = current->as_object();
+            auto it = obj.find(key);
+            if (it == obj.end()) return JSON();
+            current = &it->second;
+        } else if(path[i]=='[') {
+            i++;
+            size_t start = i;
+            while(i < path.size() && std::isdigit(path[i])) i++;
+            if(i>=path.size() || path[i]!=']') throw JSONParseError("Expected closing bracket");
+            int idx = std::stoi(path.substr(start,i-start));
+            if(!current->is_array()) return JSON();
+            const auto& arr = current->as_array();
+            if (idx < 0 || static_cast<size_t>(idx) >= arr.size()) return JSON();
+            current = &arr[idx];
+            i++;
+        } else {
+            throw JSONParseError("Invalid character in path: " + std::string(1,path[i]));
+        }
+    }
+    return *current;
+}
+
+EJSON_INLINE void JSON::set_path(const std::string& path, const JSON& val) {
+    JSON* current = this;
+    size_t i = 0;
+    std::vector<std::pair<std::string, int>> path_parts;
+    
+    while(i < path.size()) {
+        if(path[i] == '.') { i++; continue; }
+        if(std::isalpha(path[i]) || path[i]=='_') {
+            size_t start = i;
+            while(i < path.size() && (std::isalnum(path[i]) || path[i]=='_')) i++;
+            path_parts.push_back({path.substr(start,i-start), -1});
+        } else if(path[i]=='[') {
+            i++;
+            size_t start = i;
+            while(i < path.size() && std::isdigit(path[i])) i++;
+            if(i>=path.size() || path[i]!=']') throw JSONParseError("Expected closing bracket");
+            int idx = std::stoi(path.substr(start,i-start));
+            path_parts.push_back({"", idx});
+            i++;
+        } else {
+            throw JSONParseError("Invalid character in path: " + std::string(1,path[i]));
+        }
+    }
+
+    for (size_t j = 0; j < path_parts.size(); ++j) {
+        bool is_last = (j == path_parts.size() - 1);
+        const auto& [key, index] = path_parts[j];
+        
+        if (index == -1) {
+            if (current->is_null()) *current = std::map<std::string, JSON>{};
+            if (!current->is_object()) throw JSONParseError("Expected object in path");
+            
+            if (is_last) {
+                (*current)[key] = val;
+            } else {
+                current = &(*current)[key];
+            }
+        } else {
+            if (current->is_null()) *current = std::vector<JSON>{};
+            if (!current->is_array()) throw JSONParseError("Expected array in path");
+            
+            auto& arr = std::get<std::vector<JSON>>(current->value);
+            if (arr.size() <= static_cast<size_t>(index)) {
+                arr.resize(static_cast<size_t>(index) + 1);
+            }
+            
+            if (is_last) {
+                arr[index] = val;
+            } else {
+                current = &arr[index];
+            }
+        }
+    }
+}
+
+EJSON_INLINE bool JSON::operator<(const JSON& other) const {
+    // Shared and plain strings order as one type, by text.
+    if (is_string() && other.is_string()) return as_string() < other.as_string();
+    if (value.index() != other.value.index()) {
+        size_t lhs = is_string() ? 3 : value.index();
+        size_t rhs = other.is_string() ? 3 : other.value.index();
+        return lhs < rhs;
+    }
+    return std::visit(
+        [](const auto& lhs, const auto& rhs) -> bool {
+            if constexpr (std::is_same_v<decltype(lhs), decltype(rhs)>) {
+                using T = std::decay_t<decltype(lhs)>;
+                if constexpr (std::is_same_v<T, std::nullptr_t>) {
+                    return false;
+                } else {
+                    return lhs < rhs;
+                }
+            } else {
+                return false;
+            }
+        },
+        value, other.value
+    );
+}
+
+EJSON_INLINE std::string JSON::dump(bool pretty, int indent, int indent_size, int max_precision) const {
+    EJSON_TRACE_BEGIN(dump, pretty);
+    std::string out;
+    StringSink sink{out};
+    write_value(sink, pretty, indent, indent_size, max_precision);
+    EJSON_TRACE_END(dump, out.size());
+    return out;
+}
+
+EJSON_INLINE size_t JSON::dump_into(char* buf, size_t cap, bool pretty, int indent_size, int max_precision) const {
+    BufferSink sink{buf, cap};
+    write_value(sink, pretty, 0, indent_size, max_precision);
+    return sink.size;
+}
+
+EJSON_INLINE DumpSegments JSON::dump_segments(size_t reference_threshold, bool pretty, int indent_size, int max_precision) const {
+    DumpSegments result;
+    std::vector<ScatterSink::Piece> pieces;
+    ScatterSink sink{result.storage, pieces, reference_threshold};
+    write_value(sink, pretty, 0, indent_size, max_precision);
+    sink.flush();
+    result.segments.reserve(pieces.size());
+    for (const auto& piece : pieces) {
+        result.segments.push_back({piece.ref ? piece.ref : result.storage.data() + piece.offset, piece.size});
+    }
+    return result;
+}
+
+EJSON_INLINE std::string JSON::freeze() const {
+    std::string out(FrozenJSON::header_size, '\0');
+    auto append = [&out](const void* data, size_t len) { out.append(static_cast<const char*>(data), len); };
+    auto align = [&out] { out.append((8 - out.size() % 8) % 8, '\0'); };
+    auto write_string_record = [&](const std::string& str) {
+        uint64_t at = out.size();
+        unsigned char head[8] = {3, 0, 0, 0, 0, 0, 0, 0};
+        uint32_t len = static_cast<uint32_t>(str.size());
+        std::memcpy(head + 4, &len, 4);
+        append(head, 8);
+        append(str.data(), str.size());
+        out += '\0';
+        align();
+        return at;
+    };
+    // Children are written before their container so offsets are known up front.
+    auto write = [&](const JSON& node, auto& self) -> uint64_t {
+        unsigned char head[8] = {static_cast<unsigned char>(node.value.index()), 0, 0, 0, 0, 0, 0, 0};
+        if (node.is_string()) return write_string_record(node.as_string());
+        std::vector<uint64_t> links;
+        if (node.is_array()) {
+            for (const auto& item : std::get<std::vector<JSON>>(node.value)) links.push_back(self(item, self));
+        } else if (node.is_object()) {
+            for (const auto& [k, v] : std::get<std::map<std::string, JSON>>(node.value)) {
+                links.push_back(write_string_record(k));
+                links.push_back(self(v, self));
+            }
+        }
+        uint64_t at = out.size();
+        if (node.is_bool()) head[1] = std::get<bool>(node.value) ? 1 : 0;
+        uint32_t count = static_cast<uint32_t>(node.is_object() ? links.size() / 2 : links.size());
+        std::memcpy(head + 4, &count, 4);
+        append(head, 8);
+        if (node.is_number()) append(&std::get<double>(node.value), 8);
+        if (!links.empty()) append(links.data(), links.size() * 8);
+        return at;
+    };
+    uint64_t root = write(*this, write);
+    uint32_t version = 1;
+    uint64_t total = out.size();
+    std::memcpy(&out[0], "EJF1", 4);
+    std::memcpy(&out[4], &version, 4);
+    std::memcpy(&out[8], &total, 8);
+    std::memcpy(&out[16], &root, 8);
+    return out;
+}
+
+EJSON_INLINE size_t JSON::serialized_size(bool pretty, int indent_size, int max_precision) const {
+    CountingSink sink;
+    write_value(sink, pretty, 0, indent_size, max_precision);
+    return sink.size;
+}
+
+EJSON_INLINE JSON JSON::from_file(const std::string& filename, size_t max_inflated_size) {
+    EJSON_TRACE_BEGIN(from_file, filename.c_str());
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw JSONParseError("Cannot open file: " + filename);
+    }
+    std::string content;
+    if (detail::is_gzip(file)) {
+        detail::gunzip(file, content, max_inflated_size);
+    } else {
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    JSON result = parse(content);
+    EJSON_TRACE_END(from_file, content.size());
+    return result;
+}
+
+EJSON_INLINE void JSON::to_file(const std::string& filename, bool pretty) const {
+    EJSON_TRACE_BEGIN(to_file, filename.c_str());
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw JSONParseError("Cannot write to file: " + filename);
+    }
+    std::string text = dump(pretty);
+    file << text;
+    EJSON_TRACE_END(to_file, text.size());
+}
+
+EJSON_INLINE void JSON::merge(const JSON& other) {
+    if (!is_object() || !other.is_object()) {
+        throw JSONParseError("Can only merge objects");
+    }
+    auto& obj = std::get<std::map<std::string, JSON>>(value);
+    const auto& other_obj = other.as_object();
+    for (const auto& [key, val] : other_obj) {
+        obj[key] = val;
+    }
+}
+
+EJSON_INLINE JSON JSON::parse(const std::string& s) {
+    return parse(s, ParseOptions());
+}
+
+EJSON_INLINE JSON JSON::parse(const std::string& s, const ParseOptions& options) {
+    EJSON_TRACE_BEGIN(parse, s.size());
+    size_t idx = 0;
+    ValueInterner interner(options);
+    try {
+        JSON result = parse_value(s, idx, interner.enabled() ? &interner : nullptr);
+        skip_ws(s, idx);
+        if (idx < s.size()) {
+            throw JSONParseError("Extra characters after JSON at position " + std::to_string(idx));
+        }
+        EJSON_TRACE_END(parse, s.size());
+        return result;
+    } catch (const std::exception& e) {
+        throw JSONParseError("Parse error at position " + std::to_string(idx) + ": " + e.what());
+    }
+}
+
+EJSON_INLINE JSON JSON::parse_parallel(const std::string& s, unsigned threads, const ParseOptions& options) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t idx = 0;
+    skip_ws(s, idx);
+    if (threads < 2 || idx >= s.size() || (s[idx] != '[' && s[idx] != '{') ||
+        s.size() - idx < 2 * parallel_min_chunk) {
+        return parse(s, options);
+    }
+
+    const char open = s[idx];
+    const size_t body = idx + 1;
+    const size_t chunk_count = std::min<size_t>(threads, (s.size() - body) / parallel_min_chunk);
+    std::vector<size_t> bounds(chunk_count + 1);
+    for (size_t i = 0; i < chunk_count; ++i) bounds[i] = body + (s.size() - body) * i / chunk_count;
+    bounds[chunk_count] = s.size();
+
+    // Pass 1: string state transfer function of every chunk, for all start states.
+    std::vector<std::array<unsigned char, 3>> transfer(chunk_count);
+    run_chunks(chunk_count, [&](size_t c) {
+        transfer[c] = scan_string_state(s, bounds[c], bounds[c + 1]);
+    });
+    std::vector<unsigned char> start_state(chunk_count, 0);
+    for (size_t c = 1; c < chunk_count; ++c) start_state[c] = transfer[c - 1][start_state[c - 1]];
+
+    // Pass 2: nesting depth delta of every chunk, then prefix sums.
+    std::vector<long long> delta(chunk_count);
+    run_chunks(chunk_count, [&](size_t c) {
+        delta[c] = scan_depth_delta(s, bounds[c], bounds[c + 1], start_state[c]);
+    });
+    std::vector<long long> start_depth(chunk_count, 1);
+    for (size_t c = 1; c < chunk_count; ++c) start_depth[c] = start_depth[c - 1] + delta[c - 1];
+
+    // Pass 3: first top-level comma at or after each chunk start becomes a split point.
+    std::vector<size_t> split(chunk_count, std::string::npos);
+    run_chunks(chunk_count, [&](size_t c) {
+        if (c > 0) split[c] = find_top_level_comma(s, bounds[c], bounds[c + 1], start_state[c], start_depth[c]);
+    });
+
+    std::vector<size_t> starts{body};
+    for (size_t c = 1; c < chunk_count; ++c) {
+        if (split[c] != std::string::npos && split[c] + 1 > starts.back()) starts.push_back(split[c] + 1);
+    }
+    if (starts.size() < 2) return parse(s, options);
+
+    // Parse segments concurrently. Every segment but the last ends at a split comma.
+    const size_t segments = starts.size();
+    std::vector<JSON> parts(segments);
+    std::vector<size_t> ends(segments, 0);
+    run_chunks(segments, [&](size_t k) {
+        size_t stop = k + 1 < segments ? starts[k + 1] - 1 : std::string::npos;
+        size_t pos = starts[k];
+        ValueInterner interner(options);
+        try {
+            parts[k] = parse_segment(s, pos, stop, open, interner.enabled() ? &interner : nullptr);
+            ends[k] = pos;
+        } catch (const std::exception& e) {
+            throw JSONParseError("Parse error at position " + std::to_string(pos) + ": " + e.what());
+        }
+    });
+
+    JSON result = std::move(parts[0]);
+    for (size_t k = 1; k < segments; ++k) {
+        if (open == '[') {
+            auto& arr = std::get<std::vector<JSON>>(result.value);
+            auto& part = std::get<std::vector<JSON>>(parts[k].value);
+            arr.insert(arr.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+        } else {
+            auto& obj = std::get<std::map<std::string, JSON>>(result.value);
+            for (auto& [key, val] : std::get<std::map<std::string, JSON>>(parts[k].value)) {
+                obj.insert_or_assign(key, std::move(val));
+            }
+        }
+    }
+
+    idx = ends[segments - 1];
+    skip_ws(s, idx);
+    if (idx < s.size()) {
+        throw JSONParseError("Parse error at position " + std::to_string(idx) + ": Extra characters after JSON at position " + std::to_string(idx));
+    }
+    return result;
+}
+
+EJSON_INLINE bool JSON::is_valid(const std::string& s) {
+    try {
+        parse(s);
+        return true;
+    } catch (...) {
+        return false;
+    }
+}
+
+EJSON_INLINE void JSON::flatten_recursive(const JSON& obj, const std::string& prefix, JSON& result, const std::string& sep) {
+    if (obj.is_object()) {
+        for (const auto& [key, value] : obj.as_object()) {
+            std::string new_key = prefix.empty() ? key : prefix + sep + key;
+            if (value.is_object() || value.is_array()) {
+                flatten_recursive(value, new_key, result, sep);
+            } else {
+                result[new_key] = value;
+            }
+        }
+    } else if (obj.is_array()) {
+        for (size_t i = 0; i < obj.size(); ++i) {
+            std::string new_key = prefix + "[" + std::to_string(i) + "]";
+            if (obj[i].is_object() || obj[i].is_array()) {
+                flatten_recursive(obj[i], new_key, result, sep);
+            } else {
+                result[new_key] = obj[i];
+            }
+        }
+    } else {
+        result[prefix] = obj;
+    }
+}
+
+EJSON_INLINE void JSON::skip_ws(const std::string& s, size_t& idx) {
+    while(idx < s.size() && std::isspace(s[idx])) idx++;
+}
+
+EJSON_INLINE unsigned char JSON::next_string_state(unsigned char state, char c) {
+    if (state == 2) return 1;
+    if (c == '"') return state == 0 ? 1 : 0;
+    if (c == '\\' && state == 1) return 2;
+    return state;
+}
+
+EJSON_INLINE std::array<unsigned char, 3> JSON::scan_string_state(const std::string& s, size_t begin, size_t end) {
+    std::array<unsigned char, 3> state{0, 1, 2};
+    for (size_t i = begin; i < end; ++i) {
+        for (auto& st : state) st = next_string_state(st, s[i]);
+    }
+    return state;
+}
+
+EJSON_INLINE long long JSON::scan_depth_delta(const std::string& s, size_t begin, size_t end, unsigned char state) {
+    long long depth = 0;
+    for (size_t i = begin; i < end; ++i) {
+        char c = s[i];
+        if (state == 0) {
+            if (c == '[' || c == '{') depth++;
+            else if (c == ']' || c == '}') depth--;
+        }
+        state = next_string_state(state, c);
+    }
+    return depth;
+}
+
+EJSON_INLINE size_t JSON::find_top_level_comma(const std::string& s, size_t begin, size_t end, unsigned char state, long long depth) {
+    for (size_t i = begin; i < end; ++i) {
+        char c = s[i];
+        if (state == 0) {
+            if (c == '[' || c == '{') depth++;
+            else if (c == ']' || c == '}') { if (--depth <= 0) return std::string::npos; }
+            else if (c == ',' && depth == 1) return i;
+        }
+        state = next_string_state(state, c);
+    }
+    return std::string::npos;
+}
+
+EJSON_INLINE JSON JSON::parse_segment(const std::string& s, size_t& idx, size_t stop, char open, ValueInterner* interner) {
+    const char close = open == '[' ? ']' : '}';
+    std::vector<JSON> arr;
+    std::map<std::string, JSON> obj;
+    while (true) {
+        if (open == '[') {
+            arr.push_back(parse_value(s, idx, interner));
+        } else {
+            skip_ws(s, idx);
+            if (idx >= s.size() || s[idx] != '"') throw JSONParseError("Expected string key in object");
+            JSON key = parse_string(s, idx);
+            skip_ws(s, idx);
+            if (idx >= s.size() || s[idx] != ':') throw JSONParseError("Expected ':' after key in object");
+            idx++;
+            obj[key.as_string()] = parse_value(s, idx, interner);
+        }
+        skip_ws(s, idx);
+        if (idx >= s.size()) throw JSONParseError(open == '[' ? "Expected ',' or ']'" : "Expected ',' or '}' in object");
+        if (stop != std::string::npos) {
+            if (idx == stop) break;
+            if (idx > stop) throw JSONParseError("Malformed structure across parallel segment boundary");
+        }
+        if (s[idx] == ',') { idx++; continue; }
+        if (stop == std::string::npos && s[idx] == close) { idx++; break; }
+        throw JSONParseError(std::string("Unexpected character in ") + (open == '[' ? "array: " : "object: ") + s[idx]);
+    }
+    JSON part;
+    if (open == '[') part.value = std::move(arr);
+    else part.value = std::move(obj);
+    return part;
+}
+
+EJSON_INLINE void JSON::encode_utf8(std::string& res, int codepoint) {
+    if (codepoint <= 0x7F) {
+        res += static_cast<char>(codepoint);
+    } else if (codepoint <= 0x7FF) {
+        res += static_cast<char>(0xC0 | (codepoint >> 6));
+        res += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint <= 0xFFFF) {
+        res += static_cast<char>(0xE0 | (codepoint >> 12));
+        res += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        res += static_cast<char>(0x80 | (codepoint & 0x3F));
+    } else if (codepoint <= 0x10FFFF) {
+        res += static_cast<char>(0xF0 | (codepoint >> 18));
+        res += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+        res += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        res += static_cast<char>(0x80 | (codepoint & 0x3F));
+    }
+}
+
+EJSON_INLINE JSON JSON::parse_value(const std::string& s, size_t& idx, ValueInterner* interner) {
+    skip_ws(s, idx);
+    if(idx >= s.size()) throw JSONParseError("Unexpected end of input");
+
+    char c = s[idx];
+    if(c=='n') return parse_null(s, idx);
+    else if(c=='t' || c=='f') return parse_bool(s, idx);
+    else if(c=='\"') return interner ? parse_interned_string(s, idx, *interner) : parse_string(s, idx);
+    else if(c=='[') return parse_array(s, idx, interner);
+    else if(c=='{') return parse_object(s, idx, interner);
+    else if(c=='-' || std::isdigit(c)) return parse_number(s, idx);
+    throw JSONParseError(std::string("Unexpected character: ")+c);
+}
+
+EJSON_INLINE JSON JSON::parse_null(const std::string& s, size_t& idx) {
+    if(idx + 4 > s.size() || s.substr(idx,4)!="null") throw JSONParseError("Invalid null");
+    idx+=4;
+    return JSON(nullptr);
+}
+
+EJSON_INLINE JSON JSON::parse_bool(const std::string& s, size_t& idx) {
+    if(idx + 4 <= s.size() && s.substr(idx,4)=="true") { idx+=4; return JSON(true); }
+    if(idx + 5 <= s.size() && s.substr(idx,5)=="false") { idx+=5; return JSON(false); }
+    throw JSONParseError("Invalid boolean");
+}
+
+EJSON_INLINE JSON JSON::parse_number(const std::string& s, size_t& idx) {
+    size_t start = idx;
+    if(s[idx]=='-') idx++;
+    if(idx >= s.size() || !std::isdigit(s[idx])) throw JSONParseError("Invalid number");
+    
+    if(s[idx] == '0') {
+        idx++;
+    } else {
+        while(idx<s.size() && std::isdigit(s[idx])) idx++;
+    }
+    
+    if(idx<s.size() && s[idx]=='.') { 
+        idx++; 
+        if(idx >= s.size() || !std::isdigit(s[idx])) throw JSONParseError("Invalid number: missing digits after decimal point");
+        while(idx<s.size() && std::isdigit(s[idx])) idx++; 
+    }
+    
+    if(idx<s.size() && (s[idx]=='e' || s[idx]=='E')) {
+        idx++;
+        if(idx<s.size() && (s[idx]=='+' || s[idx]=='-')) idx++;
+        if(idx >= s.size() || !std::isdigit(s[idx])) throw JSONParseError("Invalid number: missing digits in exponent");
+        while(idx<s.size() && std::isdigit(s[idx])) idx++;
+    }
+    
+    try {
+        double num = std::stod(s.substr(start, idx-start));
+        return JSON(num);
+    } catch (const std::exception&) {
+        throw JSONParseError("Invalid number format");
+    }
+}
+
+EJSON_INLINE JSON JSON::parse_string(const std::string& s, size_t& idx) {
+    if(s[idx]!='"') throw JSONParseError("Expected string");
+    idx++;
+    // Fast path: a string without escapes or control characters is built from
+    // its span in one allocation; otherwise decoding resumes at the first escape.
+    size_t end = idx;
+    while (end < s.size() && s[end] != '"' && s[end] != '\\' && static_cast<unsigned char>(s[end]) >= 32) end++;
+    if (end < s.size() && s[end] == '"') {
+        JSON result(std::string(s, idx, end - idx));
+        idx = end + 1;
+        return result;
+    }
+    std::string res(s, idx, end - idx);
+    idx = end;
+    while(idx<s.size()) {
+        char c = s[idx++];
+        if(c=='"') break;
+        if(c=='\\') {
+            if(idx>=s.size()) throw JSONParseError("Invalid escape: unexpected end of string");
+            char esc = s[idx++];
+            switch(esc){
+                case '"': res+='"'; break;
+                case '\\': res+='\\'; break;
+                case '/': res+='/'; break;
+                case 'b': res+='\b'; break;
+                case 'f': res+='\f'; break;
+                case 'n': res+='\n'; break;
+                case 'r': res+='\r'; break;
+                case 't': res+='\t'; break;
+                case 'u': {
+                    if (idx + 4 > s.size()) throw JSONParseError("Invalid unicode escape");
+                    try {
+                        int codepoint = std::stoi(s.substr(idx, 4), nullptr, 16);
+                        idx += 4;
+                        
+                        if (codepoint >= 0xD800 && codepoint <= 0xDBFF) { // High surrogate
+                            if (idx + 6 > s.size() || s.substr(idx, 2) != "\\u") {
+                                throw JSONParseError("Invalid surrogate pair: high surrogate not followed by low surrogate escape");
+                            }
+                            int low_surrogate = std::stoi(s.substr(idx + 2, 4), nullptr, 16);
+                            idx += 6;
+                            
+                            if (low_surrogate < 0xDC00 || low_surrogate > 0xDFFF) {
+                                throw JSONParseError("Invalid surrogate pair: high surrogate not followed by a low surrogate");
+                            }
+                            codepoint = 0x10000 + ((codepoint - 0xD800) << 10 | (low_surrogate - 0xDC00));
+                        } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                            throw JSONParseError("Invalid surrogate pair: low surrogate without high surrogate");
+                        }
+                        
+                        encode_utf8(res, codepoint);
+                    } catch (const std::exception&) {
+                        throw JSONParseError("Invalid unicode escape sequence");
+                    }
+                    break;
+                }
+                default: throw JSONParseError("Unknown escape sequence: \\" + std::string(1, esc));
+            }
+        } else if (static_cast<unsigned char>(c) < 32) {
+            throw JSONParseError("Unescaped control character in string");
+        } else {
+            res+=c;
+        }
+    }
+    if (idx > s.size()) throw JSONParseError("Unterminated string");
+    return JSON(res);
+}
+
+EJSON_INLINE JSON JSON::parse_interned_string(const std::string& s, size_t& idx, ValueInterner& interner) {
+    size_t end = idx + 1;
+    const size_t limit = std::min(s.size(), end + interner.max_value_length() + 1);
+    while (end < limit && s[end] != '"' && s[end] != '\\' && static_cast<unsigned char>(s[end]) >= 32) end++;
+    size_t len = end - idx - 1;
+    if (end >= limit || s[end] != '"' || len <= ValueInterner::inline_length) return parse_string(s, idx);
+    JSON result = interner.get(s.data() + idx + 1, len);
+    idx = end + 1;
+    return result;
+}
+
+EJSON_INLINE JSON JSON::parse_array(const std::string& s, size_t& idx, ValueInterner* interner) {
+    if(s[idx]!='[') throw JSONParseError("Expected '['");
+    idx++;
+    std::vector<JSON> arr;
+    skip_ws(s, idx);
+    if(idx<s.size() && s[idx]==']') { idx++; return JSON(arr); }
+    while(true) {
+        arr.push_back(parse_value(s, idx, interner));
+        skip_ws(s, idx);
+        if(idx>=s.size()) throw JSONParseError("Expected ',' or ']'");
+        if(s[idx]==',') { idx++; skip_ws(s, idx); continue; }
+        if(s[idx]==']') { idx++; break; }
+        throw JSONParseError(std::string("Unexpected character in array: ")+s[idx]);
+    }
+    return JSON(arr);
+}
+
+EJSON_INLINE JSON JSON::parse_object(const std::string& s, size_t& idx, ValueInterner* interner) {
+    if(s[idx]!='{') throw JSONParseError("Expected '{'");
+    idx++;
+    std::map<std::string, JSON> obj;
+    skip_ws(s, idx);
+    if(idx < s.size() && s[idx] == '}') { idx++; return JSON(obj); }
+    while(true) {
+        skip_ws(s, idx);
+        if(idx >= s.size() || s[idx] != '"') throw JSONParseError("Expected string key in object");
+        JSON key = parse_string(s, idx);
+        skip_ws(s, idx);
+        if(idx >= s.size() || s[idx] != ':') throw JSONParseError("Expected ':' after key in object");
+        idx++;
+        JSON val = parse_value(s, idx, interner);
+        obj[key.as_string()] = val;
+        skip_ws(s, idx);
+        if(idx >= s.size()) throw JSONParseError("Expected ',' or '}' in object");
+        if(s[idx] == ',') { idx++; skip_ws(s, idx); continue; }
+        if(s[idx] == '}') { idx++; break; }
+        throw JSONParseError(std::string("Unexpected character in object: ") + s[idx]);
+    }
+    return JSON(obj);
+}
+
+// ============ TEXT FORMATTING ============
+namespace detail {
+    // Index of the first byte at or after i that is whitespace/control (<= 0x20)
+    // or a quote, or len. Scans eight bytes per step like JSON::find_escape.
+    inline size_t find_token_break(const char* data, size_t i, size_t len) {
+        const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t w;
+            std::memcpy(&w, data + i, 8);
+            uint64_t quote = w ^ (ones * '"');
+            if (((w - ones * 0x21) & ~w & highs) | ((quote - ones) & ~quote & highs)) break;
+        }
+        for (; i < len; ++i) {
+            unsigned char c = static_cast<unsigned char>(data[i]);
+            if (c <= 0x20 || c == '"') return i;
+        }
+        return len;
+    }
+
+    // Index just past the closing quote of the string opening at data[i].
+    inline size_t skip_string_lexeme(const char* data, size_t i, size_t len) {
+        const uint64_t ones = 0x0101010101010101ull, highs = 0x8080808080808080ull;
+        ++i;
+        while (true) {
+            for (; i + 8 <= len; i += 8) {
+                uint64_t w;
+                std::memcpy(&w, data + i, 8);
+                uint64_t quote = w ^ (ones * '"');
+                uint64_t backslash = w ^ (ones * '\\');
+                if ((((quote - ones) & ~quote) | ((backslash - ones) & ~backslash)) & highs) break;
+            }
+            for (; i < len && data[i] != '"' && data[i] != '\\'; ++i) {}
+            if (i >= len) throw JSONParseError("Unterminated string");
+            if (data[i] == '"') return i + 1;
+            i += 2;
+        }
+    }
+
+    inline bool is_json_space(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+}
+
+EJSON_INLINE std::string minify(std::string_view text) {
+    const char* data = text.data();
+    size_t len = text.size();
+    std::string out;
+    out.reserve(len);
+    int depth = 0;
+    size_t i = 0;
+    while (i < len) {
+        size_t run = detail::find_token_break(data, i, len);
+        for (size_t j = i; j < run; ++j) {
+            char c = data[j];
+            if (c == '{' || c == '[') ++depth;
+            else if ((c == '}' || c == ']') && --depth < 0) throw JSONParseError("Unexpected closing bracket");
+        }
+        out.append(data + i, run - i);
+        if (run >= len) break;
+        if (data[run] == '"') {
+            i = detail::skip_string_lexeme(data, run, len);
+            out.append(data + run, i - run);
+        } else if (detail::is_json_space(data[run])) {
+            i = run + 1;
+        } else {
+            throw JSONParseError("Unexpected control character");
+        }
+    }
+    if (depth != 0) throw JSONParseError("Unexpected end of input");
+    return out;
+}
+
+EJSON_INLINE std::string reformat(std::string_view text, int indent_size) {
+    const char* data = text.data();
+    size_t len = text.size();
+    std::string out;
+    out.reserve(len + len / 4);
+    int depth = 0;
+    auto newline = [&] {
+        out += '\n';
+        out.append(static_cast<size_t>(depth) * indent_size, ' ');
+    };
+    size_t i = 0;
+    while (i < len) {
+        char c = data[i];
+        if (detail::is_json_space(c)) {
+            ++i;
+        } else if (c == '"') {
+            size_t end = detail::skip_string_lexeme(data, i, len);
+            out.append(data + i, end - i);
+            i = end;
+        } else if (c == '{' || c == '[') {
+            char close = c == '{' ? '}' : ']';
+            out += c;
+            size_t next = i + 1;
+            while (next < len && detail::is_json_space(data[next])) ++next;
+            if (next < len && data[next] == close) {
+                out += close;
+                i = next + 1;
+            } else {
+                ++depth;
+                newline();
+                i = next;
+            }
+        } else if (c == '}' || c == ']') {
+            if (--depth < 0) throw JSONParseError("Unexpected closing bracket");
+            newline();
+            out += c;
+            ++i;
+        } else if (c == ',') {
+            out += ',';
+            newline();
+            ++i;
+        } else if (c == ':') {
+            out += ": ";
+            ++i;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            throw JSONParseError("Unexpected control character");
+        } else {
+            // Number or literal: copy the lexeme up to the next delimiter.
+            size_t end = i + 1;
+            while (end < len && !detail::is_json_space(data[end]) && std::strchr(",:]}\"", data[end]) == nullptr) ++end;
+            out.append(data + i, end - i);
+            i = end;
+        }
+    }
+    if (depth != 0) throw JSONParseError("Unexpected end of input");
+    return out;
+}
+
+// ============ ARRAY FILE INDEX ============
+namespace detail {
+    // Tracks strings and nesting over a top-level array and reports where each
+    // element starts and ends. Kept byte-at-a-time so a scan can resume from
+    // any element boundary recorded in the index.
+    struct ArrayScanner {
+        enum Event { None, ElementStart, ElementEnd, ArrayEnd };
+
+        int depth = 0;
+        bool in_string = false;
+        bool escaped = false;
+        bool want_element = false;
+        bool in_element = false;
+
+        // State at the first byte of an element, used to resume from a sample.
+        static ArrayScanner at_element() {
+            ArrayScanner scanner;
+            scanner.depth = 1;
+            scanner.want_element = true;
+            return scanner;
+        }
+
+        Event feed(char c) {
+            if (in_string) {
+                if (escaped) escaped = false;
+                else if (c == '\\') escaped = true;
+                else if (c == '"') in_string = false;
+                return None;
+            }
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t') return None;
+            Event event = None;
+            if (want_element && c != ']') {
+                want_element = false;
+                in_element = true;
+                event = ElementStart;
+            } else if (depth == 0 && c != '[') {
+                throw JSONParseError("Expected a top-level array");
+            }
+            switch (c) {
+                case '"': in_string = true; break;
+                case '[': case '{':
+                    if (++depth == 1) want_element = true;
+                    break;
+                case ']': case '}':
+                    if (--depth == 0) {
+                        want_element = false;
+                        if (in_element) {
+                            in_element = false;
+                            return ElementEnd;
+                        }
+                        return ArrayEnd;
+                    }
+                    break;
+                case ',':
+                    if (depth == 1) {
+                        in_element = false;
+                        want_element = true;
+                        return ElementEnd;
+                    }
+                    break;
+                default: break;
+            }
+            return event;
+        }
+    };
+
+    constexpr size_t array_file_chunk = 1 << 16;
+}
+
+EJSON_INLINE JSONArrayFile::JSONArrayFile(const std::string& path, size_t stride) : path(path), stride(stride ? stride : 1) {
+    if (!load()) {
+        build();
+        save();
+    }
+}
+
+EJSON_INLINE void JSONArrayFile::build_index(const std::string& path, size_t stride) {
+    JSONArrayFile file;
+    file.path = path;
+    file.stride = stride ? stride : 1;
+    file.build();
+    if (!file.save()) throw JSONParseError("Cannot write to file: " + index_path(path));
+}
+
+EJSON_INLINE void JSONArrayFile::build() {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw JSONParseError("Cannot open file: " + path);
+    detail::ArrayScanner scanner;
+    std::vector<char> buf(detail::array_file_chunk);
+    uint64_t base = 0;
+    count = 0;
+    samples.clear();
+    bool done = false;
+    while (!done && file) {
+        file.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        size_t got = static_cast<size_t>(file.gcount());
+        for (size_t i = 0; i < got; ++i) {
+            // Only structural bytes outside strings need the full state machine.
+            if (scanner.in_string && !scanner.escaped) {
+                const char* start = buf.data() + i;
+                const void* quote = std::memchr(start, '"', got - i);
+                size_t next = quote ? static_cast<size_t>(static_cast<const char*>(quote) - buf.data()) : got;
+                const void* slash = std::memchr(start, '\\', next - i);
+                if (slash) next = static_cast<size_t>(static_cast<const char*>(slash) - buf.data());
+                if (next >= got) break;
+                i = next;
+            }
+            auto event = scanner.feed(buf[i]);
+            if (event == detail::ArrayScanner::ElementStart) {
+                if (count % stride == 0) samples.push_back(base + i);
+                ++count;
+            } else if (event == detail::ArrayScanner::ArrayEnd || (event == detail::ArrayScanner::ElementEnd && scanner.depth == 0)) {
+                done = true;
+                break;
+            }
+        }
+        base += got;
+    }
+    if (!done) throw JSONParseError("Unexpected end of input");
+    file.clear();
+    file.seekg(0, std::ios::end);
+    file_size = static_cast<uint64_t>(file.tellg());
+    file_mtime = modification_time();
+}
+
+EJSON_INLINE uint64_t JSONArrayFile::modification_time() const {
+    std::error_code ec;
+    auto stamp = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : static_cast<uint64_t>(stamp.time_since_epoch().count());
+}
+
+EJSON_INLINE bool JSONArrayFile::load() {
+    std::ifstream data(path, std::ios::binary | std::ios::ate);
+    if (!data.is_open()) throw JSONParseError("Cannot open file: " + path);
+    uint64_t actual_size = static_cast<uint64_t>(data.tellg());
+    std::ifstream index(index_path(path), std::ios::binary);
+    if (!index.is_open()) return false;
+    char magic[4];
+    uint64_t header[5];
+    if (!index.read(magic, 4) || std::memcmp(magic, "EJAI", 4) != 0) return false;
+    if (!index.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+    if (header[0] != actual_size || header[1] != modification_time() || header[2] != stride) return false;
+    file_size = header[0];
+    file_mtime = header[1];
+    count = header[3];
+    samples.resize(static_cast<size_t>(header[4]));
+    if (samples.size() != (count + stride - 1) / stride) return false;
+    return static_cast<bool>(index.read(reinterpret_cast<char*>(samples.data()), static_cast<std::streamsize>(samples.size() * sizeof(uint64_t))));
+}
+
+EJSON_INLINE bool JSONArrayFile::save() const {
+    std::ofstream index(index_path(path), std::ios::binary | std::ios::trunc);
+    if (!index.is_open()) return false;
+    uint64_t header[5] = {file_size, file_mtime, stride, count, samples.size()};
+    index.write("EJAI", 4);
+    index.write(reinterpret_cast<const char*>(header), sizeof(header));
+    index.write(reinterpret_cast<const char*>(samples.data()), static_cast<std::streamsize>(samples.size() * sizeof(uint64_t)));
+    return static_cast<bool>(index);
+}
+
+EJSON_INLINE JSON JSONArrayFile::at(size_t i) const {
+    if (i >= count) throw JSONParseError("Array index out of bounds");
+    auto result = slice(i, i + 1);
+    return std::move(result.front());
+}
+
+EJSON_INLINE std::vector<JSON> JSONArrayFile::slice(size_t begin, size_t end) const {
+    std::vector<JSON> result;
+    if (end > count) end = static_cast<size_t>(count);
+    if (begin >= end) return result;
+    result.reserve(end - begin);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw JSONParseError("Cannot open file: " + path);
+    size_t element = begin - begin % stride;
+    file.seekg(static_cast<std::streamoff>(samples[begin / stride]));
+    detail::ArrayScanner scanner = detail::ArrayScanner::at_element();
+    std::vector<char> buf(detail::array_file_chunk);
+    std::string text;
+    bool capturing = false;
+    while (result.size() < end - begin && file) {
+        file.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        size_t got = static_cast<size_t>(file.gcount());
+        size_t run = 0;
+        for (size_t i = 0; i < got && result.size() < end - begin; ++i) {
+            auto event = scanner.feed(buf[i]);
+            if (event == detail::ArrayScanner::ElementStart && element >= begin) {
+                capturing = true;
+                run = i;
+            } else if (event == detail::ArrayScanner::ElementEnd) {
+                if (capturing) {
+                    text.append(buf.data() + run, i - run);
+                    result.push_back(JSON::parse(text));
+                    text.clear();
+                    capturing = false;
+                }
+                ++element;
+            }
+        }
+        if (capturing) text.append(buf.data() + run, got - run);
+    }
+    if (result.size() < end - begin) throw JSONParseError("Unexpected end of input");
+    return result;
+}
+
+// ============ OUTPUT TEMPLATES ============
+EJSON_INLINE Template::Template(std::string_view skeleton, int max_precision) : max_precision(max_precision) {
+    const char* data = skeleton.data();
+    size_t len = skeleton.size();
+    std::string current;
+    std::string check;  // skeleton with every placeholder replaced by null
+    size_t i = 0;
+    while (i < len) {
+        char c = data[i];
+        if (detail::is_json_space(c)) {
+            ++i;
+        } else if (c == '"') {
+            size_t end = detail::skip_string_lexeme(data, i, len);
+            current.append(data + i, end - i);
+            check.append(data + i, end - i);
+            i = end;
+        } else if (c == '$') {
+            size_t start = ++i;
+            while (i < len && (std::isalnum(static_cast<unsigned char>(data[i])) || data[i] == '_')) ++i;
+            if (i == start) throw JSONParseError("Expected placeholder name after '$'");
+            std::string name(data + start, i - start);
+            auto it = std::find(names.begin(), names.end(), name);
+            uses.push_back(static_cast<size_t>(it - names.begin()));
+            if (it == names.end()) names.push_back(std::move(name));
+            segments.push_back(std::move(current));
+            current.clear();
+            check += "null";
+        } else {
+            current += c;
+            check += c;
+            ++i;
+        }
+    }
+    segments.push_back(std::move(current));
+    if (!JSON::is_valid(check)) throw JSONParseError("Template is not valid JSON");
+}
+
+EJSON_INLINE std::string Template::render(const std::map<std::string, JSON>& values) const {
+    std::vector<Arg> table;
+    table.reserve(names.size());
+    for (const auto& name : names) {
+        auto it = values.find(name);
+        if (it == values.end()) throw JSONParseError("Missing template value: " + name);
+        table.push_back(Arg{&it->second, &write_arg<JSON>});
+    }
+    std::string out;
+    emit(out, table.data());
+    return out;
+}
+
+// ============ SHAPE PROFILING ============
+EJSON_INLINE void ShapeProfile::Histogram::add(size_t n) {
+    size_t bucket = 0;
+    for (size_t v = n; v; v >>= 1) ++bucket;
+    ++buckets[bucket];
+    ++count;
+    max = std::max(max, n);
+    total += static_cast<double>(n);
+}
+
+EJSON_INLINE void ShapeProfile::Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < buckets.size(); ++i) buckets[i] += other.buckets[i];
+    count += other.count;
+    max = std::max(max, other.max);
+    total += other.total;
+}
+
+EJSON_INLINE size_t ShapeProfile::Histogram::percentile(double p) const {
+    size_t target = static_cast<size_t>(p * static_cast<double>(count));
+    size_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen > target || seen == count) return b == 0 ? 0 : std::min(max, (size_t(1) << (b - 1)) * 2 - 1);
+    }
+    return max;
+}
+
+EJSON_INLINE JSON ShapeProfile::Histogram::to_json() const {
+    JSON out = std::map<std::string, JSON>{};
+    out["count"] = static_cast<double>(count);
+    out["max"] = static_cast<double>(max);
+    out["mean"] = count ? total / static_cast<double>(count) : 0.0;
+    out["p50"] = static_cast<double>(percentile(0.5));
+    out["p90"] = static_cast<double>(percentile(0.9));
+    out["p99"] = static_cast<double>(percentile(0.99));
+    JSON& hist = out["buckets"];
+    hist = std::map<std::string, JSON>{};
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        if (!buckets[b]) continue;
+        std::string label = b <= 1 ? std::to_string(b)
+                                   : std::to_string(size_t(1) << (b - 1)) + "-" + std::to_string((size_t(1) << (b - 1)) * 2 - 1);
+        hist[label] = static_cast<double>(buckets[b]);
+    }
+    return out;
+}
+
+EJSON_INLINE void ShapeProfile::walk(const JSON& node, size_t depth, std::string& path, size_t& max_depth) {
+    max_depth = std::max(max_depth, depth);
+    unsigned type = 1u << (node.is_string() ? 3 : node.value.index());
+    auto slot = path_types.find(path);
+    if (slot != path_types.end()) slot->second |= type;
+    else if (path_types.size() < max_tracked_paths) path_types.emplace(path, type);
+
+    if (node.is_null()) {
+        ++nulls;
+    } else if (node.is_bool()) {
+        ++bools;
+    } else if (node.is_number()) {
+        double num = node.as_number();
+        if (num == static_cast<double>(static_cast<long long>(num))) ++integers;
+        else ++fractions;
+    } else if (node.is_string()) {
+        const std::string& str = node.as_string();
+        ++strings;
+        string_lengths.add(str.size());
+        if (str.size() <= max_value_length) {
+            auto it = value_counts.find(str);
+            if (it != value_counts.end()) ++it->second;
+            else if (value_counts.size() < max_tracked_values) value_counts.emplace(str, 1);
+        }
+    } else if (node.is_array()) {
+        const auto& arr = node.as_array();
+        ++arrays;
+        array_sizes.add(arr.size());
+        size_t mark = path.size();
+        path += "[]";
+        for (const auto& el : arr) walk(el, depth + 1, path, max_depth);
+        path.resize(mark);
+    } else {
+        const auto& obj = node.as_object();
+        ++objects;
+        object_sizes.add(obj.size());
+        size_t mark = path.size();
+        for (const auto& [k, v] : obj) {
+            ++key_counts[k];
+            path += '.';
+            path += k;
+            walk(v, depth + 1, path, max_depth);
+            path.resize(mark);
+        }
+    }
+}
+
+EJSON_INLINE void ShapeProfile::add(const JSON& doc) {
+    std::string path = "$";
+    size_t max_depth = 0;
+    walk(doc, 0, path, max_depth);
+    depths.add(max_depth);
+    ++docs;
+}
+
+EJSON_INLINE void ShapeProfile::add_file(const std::string& path) {
+    add(JSON::from_file(path));
+}
+
+EJSON_INLINE void ShapeProfile::add_ndjson(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw JSONParseError("Cannot open file: " + path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        add(JSON::parse(line));
+    }
+}
+
+EJSON_INLINE void ShapeProfile::merge(const ShapeProfile& other) {
+    docs += other.docs;
+    nulls += other.nulls;
+    bools += other.bools;
+    integers += other.integers;
+    fractions += other.fractions;
+    strings += other.strings;
+    arrays += other.arrays;
+    objects += other.objects;
+    depths.merge(other.depths);
+    array_sizes.merge(other.array_sizes);
+    object_sizes.merge(other.object_sizes);
+    string_lengths.merge(other.string_lengths);
+    for (const auto& [k, n] : other.key_counts) key_counts[k] += n;
+    for (const auto& [v, n] : other.value_counts) {
+        auto it = value_counts.find(v);
+        if (it != value_counts.end()) it->second += n;
+        else if (value_counts.size() < max_tracked_values) value_counts.emplace(v, n);
+    }
+    for (const auto& [p, mask] : other.path_types) {
+        auto it = path_types.find(p);
+        if (it != path_types.end()) it->second |= mask;
+        else if (path_types.size() < max_tracked_paths) path_types.emplace(p, mask);
+    }
+}
+
+EJSON_INLINE ShapeProfile ShapeProfile::profile_files(const std::vector<std::string>& paths, bool ndjson, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, paths.size())));
+    std::vector<std::future<ShapeProfile>> parts;
+    for (unsigned t = 0; t < threads; ++t) {
+        parts.push_back(std::async(std::launch::async, [&paths, ndjson, threads, t] {
+            ShapeProfile part;
+            for (size_t i = t; i < paths.size(); i += threads) {
+                if (ndjson) part.add_ndjson(paths[i]);
+                else part.add_file(paths[i]);
+            }
+            return part;
+        }));
+    }
+    ShapeProfile result;
+    for (auto& part : parts) result.merge(part.get());
+    return result;
+}
+
+EJSON_INLINE ParseOptions ShapeProfile::suggested_parse_options() const {
+    ParseOptions options;
+    size_t repeated = 0, distinct = 0, longest = 0, candidates = 0;
+    for (const auto& [v, n] : value_counts) {
+        // Values that fit std::string's inline buffer gain nothing from sharing.
+        if (v.size() <= std::string().capacity()) continue;
+        candidates += n;
+        if (n < 2) continue;
+        repeated += n;
+        ++distinct;
+        longest = std::max(longest, v.size());
+    }
+    // Interning pays off once a sizeable share of string values are repeats.
+    options.intern_values = candidates > 0 && repeated * 4 >= strings;
+    if (options.intern_values) {
+        options.intern_max_length = longest;
+        size_t capacity = 64;
+        while (capacity < distinct * 2) capacity <<= 1;
+        options.intern_capacity = capacity;
+    }
+    return options;
+}
+
+EJSON_INLINE JSON ShapeProfile::report() const {
+    static const char* const type_names[] = {"null", "boolean", "number", "string", "array", "object"};
+    JSON out = std::map<std::string, JSON>{};
+    out["documents"] = static_cast<double>(docs);
+    JSON& types = out["types"];
+    types["null"] = static_cast<double>(nulls);
+    types["boolean"] = static_cast<double>(bools);
+    types["integer"] = static_cast<double>(integers);
+    types["fraction"] = static_cast<double>(fractions);
+    types["string"] = static_cast<double>(strings);
+    types["array"] = static_cast<double>(arrays);
+    types["object"] = static_cast<double>(objects);
+    out["depth"] = depths.to_json();
+    out["array_sizes"] = array_sizes.to_json();
+    out["object_sizes"] = object_sizes.to_json();
+    out["string_lengths"] = string_lengths.to_json();
+
+    JSON& keys = out["keys"];
+    keys = std::map<std::string, JSON>{};
+    for (const auto& [k, n] : key_counts) keys[k] = static_cast<double>(n);
+
+    std::vector<std::pair<size_t, const std::string*>> repeats;
+    for (const auto& [v, n] : value_counts) {
+        if (n >= 2) repeats.emplace_back(n, &v);
+    }
+    std::sort(repeats.begin(), repeats.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    JSON& repeated = out["repeated_values"];
+    repeated = std::vector<JSON>{};
+    for (size_t i = 0; i < repeats.size() && i < 20; ++i) {
+        repeated.push_back(object({{"value", *repeats[i].second}, {"count", static_cast<double>(repeats[i].first)}}));
+    }
+
+    JSON& schema = out["schema"];
+    schema = std::map<std::string, JSON>{};
+    for (const auto& [p, mask] : path_types) {
+        std::string kinds;
+        for (unsigned t = 0; t < 6; ++t) {
+            if (!(mask & (1u << t))) continue;
+            if (!kinds.empty()) kinds += '|';
+            kinds += type_names[t];
+        }
+        schema[p] = kinds;
+    }
+
+    ParseOptions options = suggested_parse_options();
+    JSON& hints = out["suggestions"];
+    hints["intern_values"] = options.intern_values;
+    hints["intern_max_length"] = static_cast<double>(options.intern_max_length);
+    hints["intern_capacity"] = static_cast<double>(options.intern_capacity);
+    hints["array_reserve"] = static_cast<double>(array_sizes.percentile(0.9));
+    hints["integers_only"] = fractions == 0 && integers > 0;
+    return out;
+}
+
+// ============ ARRAY EDITING ============
+EJSON_INLINE ArrayEditor::ArrayEditor(JSON& array) {
+    if (array.is_null()) array.value = std::vector<JSON>{};
+    if (!array.is_array()) throw JSONParseError("Not an array");
+    arr = &std::get<std::vector<JSON>>(array.value);
+}
+
+EJSON_INLINE JSON& ArrayEditor::operator[](size_t idx) {
+    if (idx >= size()) throw JSONParseError("Array index out of bounds");
+    return (*arr)[head + idx];
+}
+
+EJSON_INLINE const JSON& ArrayEditor::operator[](size_t idx) const {
+    if (idx >= size()) throw JSONParseError("Array index out of bounds");
+    return (*arr)[head + idx];
+}
+
+EJSON_INLINE JSON ArrayEditor::pop_front() {
+    if (empty()) throw JSONParseError("Array is empty");
+    JSON out = std::move((*arr)[head]);
+    (*arr)[head++] = JSON();
+    reclaim();
+    return out;
+}
+
+EJSON_INLINE JSON ArrayEditor::pop_back() {
+    if (empty()) throw JSONParseError("Array is empty");
+    JSON out = std::move(arr->back());
+    arr->pop_back();
+    reclaim();
+    return out;
+}
+
+EJSON_INLINE void ArrayEditor::insert(size_t index, const JSON& item) {
+    size_t count = size();
+    if (index > count) throw JSONParseError("Index out of bounds");
+    if (index > count / 2) {
+        arr->insert(arr->begin() + head + index, item);
+        return;
+    }
+    JSON copy = item;  // item may live in the array
+    if (head == 0) {
+        // Open a gap as large as the array, so the next count front
+        // inserts need no reallocation.
+        size_t gap = std::max(min_gap, count);
+        std::vector<JSON> grown;
+        grown.reserve(gap + count);
+        grown.resize(gap);
+        std::move(arr->begin(), arr->end(), std::back_inserter(grown));
+        arr->swap(grown);
+        head = gap;
+    }
+    std::move(arr->begin() + head, arr->begin() + head + index, arr->begin() + head - 1);
+    --head;
+    (*arr)[head + index] = std::move(copy);
+}
+
+EJSON_INLINE void ArrayEditor::erase(size_t index) {
+    size_t count = size();
+    if (index >= count) throw JSONParseError("Index out of bounds");
+    if (index < count / 2) {
+        std::move_backward(arr->begin() + head, arr->begin() + head + index, arr->begin() + head + index + 1);
+        (*arr)[head++] = JSON();
+    } else {
+        arr->erase(arr->begin() + head + index);
+    }
+    reclaim();
+}
+
+EJSON_INLINE void ArrayEditor::commit() {
+    if (!head) return;
+    arr->erase(arr->begin(), arr->begin() + head);
+    head = 0;
+}
+
+// Closes the gap once it outgrows the live elements, keeping the vector at
+// most about twice the array's size.
+EJSON_INLINE void ArrayEditor::reclaim() {
+    if (empty()) {
+        arr->clear();
+        head = 0;
+    } else if (head >= min_gap && head > size()) {
+        commit();
+    }
+}
+
+// ============ INCREMENTAL DUMP ============
+EJSON_INLINE JSON& CachedDocument::edit(const std::string& path) {
+    JSON* current = &doc;
+    std::string key;
+    cache.erase(key);
+    size_t i = 0;
+    while (i < path.size()) {
+        if (path[i] == '.') { i++; continue; }
+        if (std::isalpha(static_cast<unsigned char>(path[i])) || path[i] == '_') {
+            size_t start = i;
+            while (i < path.size() && (std::isalnum(static_cast<unsigned char>(path[i])) || path[i] == '_')) i++;
+            if (current->is_null()) *current = std::map<std::string, JSON>{};
+            if (!current->is_object()) throw JSONParseError("Expected object in path");
+            std::string name = path.substr(start, i - start);
+            key += 'k';
+            key += std::to_string(name.size());
+            key += ':';
+            key += name;
+            current = &(*current)[name];
+        } else if (path[i] == '[') {
+            size_t start = ++i;
+            while (i < path.size() && std::isdigit(static_cast<unsigned char>(path[i]))) i++;
+            if (i >= path.size() || path[i] != ']') throw JSONParseError("Expected closing bracket");
+            size_t index = std::stoul(path.substr(start, i - start));
+            i++;
+            if (current->is_null()) *current = std::vector<JSON>{};
+            if (!current->is_array()) throw JSONParseError("Expected array in path");
+            auto& arr = std::get<std::vector<JSON>>(current->value);
+            if (arr.size() <= index) arr.resize(index + 1);
+            key += 'i';
+            key += std::to_string(index);
+            key += ';';
+            current = &arr[index];
+        } else {
+            throw JSONParseError("Invalid character in path: " + std::string(1, path[i]));
+        }
+        cache.erase(key);
+    }
+    auto it = cache.lower_bound(key);
+    while (it != cache.end() && it->first.compare(0, key.size(), key) == 0) it = cache.erase(it);
+    return *current;
+}
+
+EJSON_INLINE std::string CachedDocument::dump(int max_precision) {
+    if (max_precision != precision) {
+        cache.clear();
+        precision = max_precision;
+    }
+    std::string out;
+    std::string key;
+    write(doc, key, out);
+    return out;
+}
+
+EJSON_INLINE void CachedDocument::write(const JSON& node, std::string& key, std::string& out) {
+    JSON::StringSink sink{out};
+    if (!node.is_array() && !node.is_object()) {
+        node.write_value(sink, false, 0, 0, precision);
+        return;
+    }
+    auto hit = cache.find(key);
+    if (hit != cache.end()) {
+        out += hit->second;
+        return;
+    }
+    size_t start = out.size();
+    size_t key_size = key.size();
+    if (node.is_array()) {
+        const auto& arr = std::get<std::vector<JSON>>(node.value);
+        sink.put('[');
+        for (size_t i = 0; i < arr.size(); ++i) {
+            if (i) sink.put(',');
+            key += 'i';
+            key += std::to_string(i);
+            key += ';';
+            write(arr[i], key, out);
+            key.resize(key_size);
+        }
+        sink.put(']');
+    } else {
+        sink.put('{');
+        bool first = true;
+        for (const auto& [k, v] : std::get<std::map<std::string, JSON>>(node.value)) {
+            if (!first) sink.put(',');
+            first = false;
+            JSON::write_string(sink, k);
+            sink.put(':');
+            key += 'k';
+            key += std::to_string(k.size());
+            key += ':';
+            key += k;
+            write(v, key, out);
+            key.resize(key_size);
+        }
+        sink.put('}');
+    }
+    // Small containers are cheaper to re-serialize than to keep a copy of.
+    if (out.size() - start >= min_bytes) cache.emplace(key, out.substr(start));
+}
+
+// ============ CONCURRENT DOCUMENTS ============
+EJSON_INLINE ConcurrentDocument::ConcurrentDocument(size_t stripes) : stripes(stripes ? stripes : 1) {}
+
+EJSON_INLINE ConcurrentDocument::ConcurrentDocument(const JSON& initial, size_t stripes) : stripes(stripes ? stripes : 1) {
+    for (const auto& [key, val] : initial.as_object()) {
+        std::atomic_store(&slot_for(key)->value, std::make_shared<const JSON>(val));
+    }
+}
+
+EJSON_INLINE ConcurrentDocument::Stripe& ConcurrentDocument::stripe_for(const std::string& key) const {
+    return const_cast<Stripe&>(stripes[std::hash<std::string>{}(key) % stripes.size()]);
+}
+
+EJSON_INLINE std::shared_ptr<ConcurrentDocument::Slot> ConcurrentDocument::find_slot(const std::string& key) const {
+    Stripe& stripe = stripe_for(key);
+    std::shared_lock<std::shared_mutex> guard(stripe.lock);
+    auto it = stripe.slots.find(key);
+    return it == stripe.slots.end() ? nullptr : it->second;
+}
+
+EJSON_INLINE std::shared_ptr<ConcurrentDocument::Slot> ConcurrentDocument::slot_for(const std::string& key) {
+    if (auto slot = find_slot(key)) return slot;
+    Stripe& stripe = stripe_for(key);
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    auto& slot = stripe.slots[key];
+    if (!slot) slot = std::make_shared<Slot>();
+    return slot;
+}
+
+EJSON_INLINE std::pair<std::string, std::string> ConcurrentDocument::split_path(const std::string& path) {
+    size_t i = 0;
+    while (i < path.size() && (std::isalnum(static_cast<unsigned char>(path[i])) || path[i] == '_')) ++i;
+    if (i == 0) throw JSONParseError("Path must start with a top-level key: " + path);
+    size_t rest = i < path.size() && path[i] == '.' ? i + 1 : i;
+    return {path.substr(0, i), path.substr(rest)};
+}
+
+EJSON_INLINE std::shared_ptr<const JSON> ConcurrentDocument::snapshot(const std::string& key) const {
+    auto slot = find_slot(key);
+    return slot ? std::atomic_load(&slot->value) : nullptr;
+}
+
+EJSON_INLINE JSON ConcurrentDocument::get_path(const std::string& path) const {
+    auto [key, rest] = split_path(path);
+    auto current = snapshot(key);
+    if (!current) return JSON();
+    return rest.empty() ? *current : current->at_path(rest);
+}
+
+EJSON_INLINE void ConcurrentDocument::set_path(const std::string& path, const JSON& val) {
+    update_path(path, [&val](JSON& target) { target = val; });
+}
+
+EJSON_INLINE void ConcurrentDocument::update_path(const std::string& path, const std::function<void(JSON&)>& fn) {
+    auto [key, rest] = split_path(path);
+    for (;;) {
+        auto slot = slot_for(key);
+        std::lock_guard<std::mutex> guard(slot->write);
+        // Erased while we waited: publishing here would be lost, so start
+        // over on the slot now in the map.
+        if (slot->erased) continue;
+        auto current = std::atomic_load(&slot->value);
+        JSON next = current ? *current : JSON();
+        if (rest.empty()) {
+            fn(next);
+        } else {
+            JSON target = next.at_path(rest);
+            fn(target);
+            next.set_path(rest, target);
+        }
+        std::atomic_store(&slot->value, std::make_shared<const JSON>(std::move(next)));
+        return;
+    }
+}
+
+EJSON_INLINE bool ConcurrentDocument::erase(const std::string& key) {
+    auto slot = find_slot(key);
+    if (!slot) return false;
+    // Holding the slot's write lock orders the erase after any update in
+    // flight, and the erased flag turns away updates that were waiting.
+    std::lock_guard<std::mutex> write(slot->write);
+    if (slot->erased) return false;
+    Stripe& stripe = stripe_for(key);
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    stripe.slots.erase(key);
+    slot->erased = true;
+    return std::atomic_load(&slot->value) != nullptr;
+}
+
+EJSON_INLINE size_t ConcurrentDocument::size() const {
+    size_t total = 0;
+    for (const auto& stripe : stripes) {
+        std::shared_lock<std::shared_mutex> guard(stripe.lock);
+        for (const auto& [key, slot] : stripe.slots) {
+            if (std::atomic_load(&slot->value)) ++total;
+        }
+    }
+    return total;
+}
+
+EJSON_INLINE JSON ConcurrentDocument::to_json() const {
+    std::map<std::string, JSON> out;
+    for (const auto& stripe : stripes) {
+        std::shared_lock<std::shared_mutex> guard(stripe.lock);
+        for (const auto& [key, slot] : stripe.slots) {
+            if (auto value = std::atomic_load(&slot->value)) out.emplace(key, *value);
+        }
+    }
+    return JSON(out);
+}
+
+// ============ INDEXED COLLECTIONS ============
+EJSON_INLINE std::vector<Collection::Step> Collection::parse_steps(const std::string& path) {
+    std::vector<Step> steps;
+    size_t i = 0;
+    while (i < path.size()) {
+        if (path[i] == '.') { i++; continue; }
+        Step step;
+        if (std::isalpha(static_cast<unsigned char>(path[i])) || path[i] == '_') {
+            size_t start = i;
+            while (i < path.size() && (std::isalnum(static_cast<unsigned char>(path[i])) || path[i] == '_')) i++;
+            step.key = path.substr(start, i - start);
+        } else if (path[i] == '[') {
+            size_t start = ++i;
+            if (i < path.size() && path[i] == '*') {
+                step.kind = Step::Each;
+                i++;
+            } else {
+                while (i < path.size() && std::isdigit(static_cast<unsigned char>(path[i]))) i++;
+                if (i == start) throw JSONParseError("Expected index or '*' in path");
+                step.kind = Step::Index;
+                step.index = std::stoul(path.substr(start, i - start));
+            }
+            if (i >= path.size() || path[i] != ']') throw JSONParseError("Expected closing bracket");
+            i++;
+        } else {
+            throw JSONParseError("Invalid character in path: " + std::string(1, path[i]));
+        }
+        steps.push_back(std::move(step));
+    }
+    return steps;
+}
+
+template<typename Node>
+void Collection::collect(const Node& node, const std::vector<Step>& steps, size_t i, std::vector<JSON>& out) {
+    if (i == steps.size()) {
+        if constexpr (std::is_same_v<Node, FrozenJSON>) out.push_back(node.thaw());
+        else out.push_back(node);
+        return;
+    }
+    const Step& step = steps[i];
+    if (step.kind == Step::Key) {
+        if (node.is_object() && node.contains(step.key)) collect(node[step.key], steps, i + 1, out);
+    } else if (node.is_array()) {
+        if (step.kind == Step::Index) {
+            if (step.index < node.size()) collect(node[step.index], steps, i + 1, out);
+        } else {
+            for (size_t k = 0; k < node.size(); ++k) collect(node[k], steps, i + 1, out);
+        }
+    }
+}
+
+EJSON_INLINE void Collection::index_document(Index& index, Id id, const FrozenJSON& doc, bool add) {
+    std::vector<JSON> values;
+    collect(doc, index.steps, 0, values);
+    for (const auto& value : values) {
+        if (index.kind == IndexKind::Hash) {
+            std::string key = hash_key(value);
+            if (add) {
+                index.hashed[key].insert(id);
+            } else {
+                auto it = index.hashed.find(key);
+                if (it != index.hashed.end() && it->second.erase(id) && it->second.empty()) index.hashed.erase(it);
+            }
+        } else {
+            if (add) {
+                index.ordered[value].insert(id);
+            } else {
+                auto it = index.ordered.find(value);
+                if (it != index.ordered.end() && it->second.erase(id) && it->second.empty()) index.ordered.erase(it);
+            }
+        }
+    }
+}
+
+EJSON_INLINE void Collection::index_document(Id id, bool add) {
+    FrozenJSON doc = view(id);
+    for (auto& [path, index] : indexes) index_document(index, id, doc, add);
+}
+
+EJSON_INLINE void Collection::create_index(const std::string& path, IndexKind kind) {
+    Index index;
+    index.kind = kind;
+    index.steps = parse_steps(path);
+    for (Id id = 0; id < docs.size(); ++id) {
+        if (contains(id)) index_document(index, id, view(id), true);
+    }
+    indexes[path] = std::move(index);
+}
+
+EJSON_INLINE bool Collection::drop_index(const std::string& path) {
+    return indexes.erase(path) > 0;
+}
+
+EJSON_INLINE Collection::Id Collection::insert(const JSON& doc) {
+    Id id = docs.size();
+    docs.push_back(doc.freeze());
+    ++live;
+    index_document(id, true);
+    return id;
+}
+
+EJSON_INLINE void Collection::update(Id id, const JSON& doc) {
+    if (!contains(id)) throw JSONParseError("No document with id " + std::to_string(id));
+    index_document(id, false);
+    docs[id] = doc.freeze();
+    index_document(id, true);
+}
+
+EJSON_INLINE bool Collection::remove(Id id) {
+    if (!contains(id)) return false;
+    index_document(id, false);
+    std::string().swap(docs[id]);
+    --live;
+    return true;
+}
+
+EJSON_INLINE JSON Collection::get(Id id) const {
+    return view(id).thaw();
+}
+
+EJSON_INLINE FrozenJSON Collection::view(Id id) const {
+    if (!contains(id)) throw JSONParseError("No document with id " + std::to_string(id));
+    return FrozenJSON(docs[id].data(), docs[id].size());
+}
+
+EJSON_INLINE std::vector<Collection::Id> Collection::find(const std::string& path, const JSON& value) const {
+    auto it = indexes.find(path);
+    if (it != indexes.end()) {
+        const Index& index = it->second;
+        if (index.kind == IndexKind::Hash) {
+            auto hit = index.hashed.find(hash_key(value));
+            return hit == index.hashed.end() ? std::vector<Id>{} : std::vector<Id>(hit->second.begin(), hit->second.end());
+        }
+        auto hit = index.ordered.find(value);
+        return hit == index.ordered.end() ? std::vector<Id>{} : std::vector<Id>(hit->second.begin(), hit->second.end());
+    }
+    std::vector<Step> steps = parse_steps(path);
+    return scan([&steps, &value](const FrozenJSON& doc) {
+        std::vector<JSON> values;
+        collect(doc, steps, 0, values);
+        return std::find(values.begin(), values.end(), value) != values.end();
+    });
+}
+
+EJSON_INLINE std::vector<Collection::Id> Collection::range(const std::string& path, const JSON& low, const JSON& high) const {
+    auto it = indexes.find(path);
+    if (it != indexes.end() && it->second.kind == IndexKind::Ordered) {
+        std::set<Id> ids;
+        const auto& ordered = it->second.ordered;
+        for (auto hit = ordered.lower_bound(low); hit != ordered.end() && !(high < hit->first); ++hit) {
+            ids.insert(hit->second.begin(), hit->second.end());
+        }
+        return std::vector<Id>(ids.begin(), ids.end());
+    }
+    std::vector<Step> steps = parse_steps(path);
+    return scan([&steps, &low, &high](const FrozenJSON& doc) {
+        std::vector<JSON> values;
+        collect(doc, steps, 0, values);
+        for (const auto& v : values) {
+            if (!(v < low) && !(high < v)) return true;
+        }
+        return false;
+    });
+}
+
+EJSON_INLINE std::vector<Collection::Id> Collection::scan(const std::function<bool(const FrozenJSON&)>& pred, unsigned threads) const {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    // Small collections are not worth the thread start-up.
+    size_t per_thread = std::max<size_t>(4096, (docs.size() + threads - 1) / threads);
+    std::vector<std::future<std::vector<Id>>> parts;
+    for (size_t begin = 0; begin < docs.size(); begin += per_thread) {
+        size_t end = std::min(docs.size(), begin + per_thread);
+        auto work = [this, &pred, begin, end] {
+            std::vector<Id> hits;
+            for (Id id = begin; id < end; ++id) {
+                if (contains(id) && pred(view(id))) hits.push_back(id);
+            }
+            return hits;
+        };
+        parts.push_back(std::async(parts.empty() ? std::launch::deferred : std::launch::async, work));
+    }
+    std::vector<Id> result;
+    for (auto& part : parts) {
+        auto hits = part.get();
+        result.insert(result.end(), hits.begin(), hits.end());
+    }
+    return result;
+}
+
+// ============ DELTA LOG STORE ============
+EJSON_INLINE DeltaStore::DeltaStore(const std::string& base_path, const Options& options) : base(base_path), options(options) {
+    recover();
+}
+
+EJSON_INLINE DeltaStore::~DeltaStore() {
+    if (log) std::fclose(log);
+}
+
+EJSON_INLINE bool DeltaStore::sync_file(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#if defined(__unix__) || defined(__APPLE__)
+    if (fsync(fileno(file)) != 0) return false;
+#endif
+    return true;
+}
+
+// Makes a rename in the store's directory durable.
+EJSON_INLINE void DeltaStore::sync_directory() const {
+#if defined(__unix__) || defined(__APPLE__)
+    std::string dir = std::filesystem::path(base).parent_path().string();
+    if (dir.empty()) dir = ".";
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd < 0) throw JSONParseError("Cannot sync directory: " + dir);
+    bool ok = fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok) throw JSONParseError("Cannot sync directory: " + dir);
+#endif
+}
+
+EJSON_INLINE void DeltaStore::open_log(const char* mode) {
+    if (log) std::fclose(log);
+    log = std::fopen((base + ".log").c_str(), mode);
+    if (!log) throw JSONParseError("Cannot write to file: " + base + ".log");
+}
+
+EJSON_INLINE void DeltaStore::recover() {
+    std::ifstream snapshot(base + ".snapshot", std::ios::binary);
+    if (snapshot.is_open()) {
+        std::string content((std::istreambuf_iterator<char>(snapshot)), std::istreambuf_iterator<char>());
+        JSON stored = JSON::parse(content);
+        current_version = static_cast<uint64_t>(stored["version"].as_int64());
+        doc = stored["document"];
+    }
+
+    // Replay versions newer than the snapshot; older lines are left over from
+    // a crash between writing a snapshot and truncating the log.
+    std::ifstream in(base + ".log", std::ios::binary);
+    std::string line;
+    size_t valid_bytes = 0;
+    bool torn = false;
+    while (in.is_open() && std::getline(in, line)) {
+        if (in.eof()) {
+            torn = true;  // no trailing newline: the append never completed
+            break;
+        }
+        JSON entry;
+        try {
+            entry = JSON::parse(line);
+        } catch (const JSONParseError&) {
+            if (in.peek() != std::char_traits<char>::eof()) throw;
+            torn = true;
+            break;
+        }
+        valid_bytes += line.size() + 1;
+        uint64_t v = static_cast<uint64_t>(entry["v"].as_int64());
+        if (v <= current_version) continue;
+        apply(doc, entry["ops"]);
+        current_version = v;
+    }
+    in.close();
+    if (torn) {
+        std::error_code ec;
+        std::filesystem::resize_file(base + ".log", valid_bytes, ec);
+    }
+    open_log("ab");
+    log_size = valid_bytes;
+}
+
+EJSON_INLINE void DeltaStore::checkpoint() {
+    JSON stored;
+    stored["version"] = static_cast<double>(current_version);
+    stored["document"] = doc;
+    std::string text = stored.dump(false, 0, 2, 17);
+    std::string tmp = base + ".snapshot.tmp";
+    std::FILE* out = std::fopen(tmp.c_str(), "wb");
+    if (!out) throw JSONParseError("Cannot write to file: " + tmp);
+    bool ok = std::fwrite(text.data(), 1, text.size(), out) == text.size();
+    if (options.sync) ok = sync_file(out) && ok;
+    ok = std::fclose(out) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), (base + ".snapshot").c_str()) != 0) {
+        throw JSONParseError("Cannot write to file: " + base + ".snapshot");
+    }
+    if (options.sync) sync_directory();
+    open_log("wb");
+    log_size = 0;
+    if (options.sync && !sync_file(log)) throw JSONParseError("Cannot write to file: " + base + ".log");
+}
+
+EJSON_INLINE uint64_t DeltaStore::append(const JSON& ops) {
+    JSON entry;
+    entry["v"] = static_cast<double>(current_version + 1);
+    entry["ops"] = ops;
+    std::string line = entry.dump(false, 0, 2, 17);
+    line += '\n';
+    bool ok = std::fwrite(line.data(), 1, line.size(), log) == line.size();
+    ok = (options.sync ? sync_file(log) : std::fflush(log) == 0) && ok;
+    if (!ok) {
+        // Drop whatever part of the line reached the file so later appends
+        // do not land after a torn entry.
+        std::fclose(log);
+        log = nullptr;
+        std::error_code ec;
+        std::filesystem::resize_file(base + ".log", log_size, ec);
+        open_log("ab");
+        throw JSONParseError("Cannot write to file: " + base + ".log");
+    }
+    log_size += line.size();
+    return ++current_version;
+}
+
+EJSON_INLINE void DeltaStore::checkpoint_if_due() {
+    if (log_size >= options.checkpoint_bytes) checkpoint();
+}
+
+EJSON_INLINE uint64_t DeltaStore::save(const JSON& next) {
+    JSON ops = diff(doc, next);
+    if (ops.empty()) return current_version;
+    uint64_t v = append(ops);
+    doc = next;
+    checkpoint_if_due();
+    return v;
+}
+
+EJSON_INLINE uint64_t DeltaStore::set(const std::vector<JSON>& path, const JSON& value) {
+    check_path(doc, path, false);
+    JSON ops = std::vector<JSON>{object({{"op", "set"}, {"path", JSON(path)}, {"value", value}})};
+    uint64_t v = append(ops);
+    apply(doc, ops);
+    checkpoint_if_due();
+    return v;
+}
+
+EJSON_INLINE uint64_t DeltaStore::remove(const std::vector<JSON>& path) {
+    check_path(doc, path, true);
+    JSON ops = std::vector<JSON>{object({{"op", "remove"}, {"path", JSON(path)}})};
+    uint64_t v = append(ops);
+    apply(doc, ops);
+    checkpoint_if_due();
+    return v;
+}
+
+// set() creates missing keys and indexes (and turns nulls into containers)
+// along the way, so only type mismatches and negative indexes fail; remove()
+// needs every container on the path to exist.
+EJSON_INLINE void DeltaStore::check_path(const JSON& doc, const std::vector<JSON>& path, bool is_remove) {
+    const JSON* node = &doc;
+    for (size_t i = 0; i < path.size(); ++i) {
+        const JSON& step = path[i];
+        if (!step.is_number() && !step.is_string()) throw JSONParseError("Path segments must be keys or indexes");
+        if (step.is_number() && step.as_number() < 0) throw JSONParseError("Negative array index in path");
+        if (!node || (node->is_null() && !is_remove)) {
+            node = nullptr;  // created by set()
+            continue;
+        }
+        bool last = i + 1 == path.size();
+        if (step.is_number()) {
+            if (!node->is_array()) throw JSONParseError("Not an array");
+            size_t idx = static_cast<size_t>(step.as_int64());
+            if (idx < node->size()) node = &(*node)[idx];
+            else if (is_remove) throw JSONParseError("Index out of bounds");
+            else node = nullptr;
+        } else {
+            if (!node->is_object()) throw JSONParseError("Not an object");
+            if (node->contains(step.as_string())) node = &(*node)[step.as_string()];
+            else if (is_remove && !last) throw JSONParseError("Path does not exist: " + step.as_string());
+            else node = nullptr;
+        }
+    }
+}
+
+EJSON_INLINE JSON DeltaStore::diff(const JSON& from, const JSON& to) {
+    JSON ops = std::vector<JSON>{};
+    std::vector<JSON> path;
+    diff_into(from, to, path, ops);
+    return ops;
+}
+
+EJSON_INLINE void DeltaStore::diff_into(const JSON& from, const JSON& to, std::vector<JSON>& path, JSON& ops) {
+    if (from == to) return;
+    if (from.is_object() && to.is_object()) {
+        const auto& a = from.as_object();
+        const auto& b = to.as_object();
+        for (const auto& [key, val] : a) {
+            if (b.count(key)) continue;
+            path.push_back(key);
+            ops.push_back(object({{"op", "remove"}, {"path", JSON(path)}}));
+            path.pop_back();
+        }
+        for (const auto& [key, val] : b) {
+            path.push_back(key);
+            auto it = a.find(key);
+            if (it == a.end()) ops.push_back(object({{"op", "set"}, {"path", JSON(path)}, {"value", val}}));
+            else diff_into(it->second, val, path, ops);
+            path.pop_back();
+        }
+        return;
+    }
+    if (from.is_array() && to.is_array() && from.size() <= to.size() && from.size() > 0) {
+        // Element-wise edits and appends; shrinking arrays are replaced whole.
+        for (size_t i = 0; i < to.size(); ++i) {
+            path.push_back(static_cast<double>(i));
+            if (i < from.size()) diff_into(from[i], to[i], path, ops);
+            else ops.push_back(object({{"op", "set"}, {"path", JSON(path)}, {"value", to[i]}}));
+            path.pop_back();
+        }
+        return;
+    }
+    ops.push_back(object({{"op", "set"}, {"path", JSON(path)}, {"value", to}}));
+}
+
+EJSON_INLINE void DeltaStore::apply(JSON& doc, const JSON& ops) {
+    for (const auto& op : ops.as_array()) {
+        const auto& path = op["path"].as_array();
+        bool is_remove = op["op"].as_string() == "remove";
+        if (path.empty()) {
+            doc = is_remove ? JSON() : op["value"];
+            continue;
+        }
+        JSON* target = &doc;
+        for (size_t i = 0; i + 1 < path.size(); ++i) {
+            target = path[i].is_number() ? &(*target)[static_cast<size_t>(path[i].as_int64())] : &(*target)[path[i].as_string()];
+        }
+        const JSON& last = path.back();
+        if (!is_remove) {
+            if (last.is_number()) (*target)[static_cast<size_t>(last.as_int64())] = op["value"];
+            else (*target)[last.as_string()] = op["value"];
+        } else if (last.is_number()) {
+            target->erase(static_cast<size_t>(last.as_int64()));
+        } else {
+            target->erase(last.as_string());
+        }
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// ============ SHARED-MEMORY PUBLICATION ============
+namespace detail {
+    inline std::string shm_name(const std::string& name) {
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+    }
+
+    inline std::string shm_segment_name(const std::string& name, uint64_t generation) {
+        return name + "." + std::to_string(generation);
+    }
+}
+
+EJSON_INLINE SharedJSONPublisher::SharedJSONPublisher(const std::string& name) : name(detail::shm_name(name)) {
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) throw JSONParseError("Cannot open shared memory: " + this->name);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (st.st_size < static_cast<off_t>(sizeof(uint64_t)) && ftruncate(fd, sizeof(uint64_t)) != 0)) {
+        close(fd);
+        throw JSONParseError("Cannot size shared memory: " + this->name);
+    }
+    void* mem = mmap(nullptr, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) throw JSONParseError("Cannot map shared memory: " + this->name);
+    generation = static_cast<std::atomic<uint64_t>*>(mem);
+}
+
+EJSON_INLINE SharedJSONPublisher::~SharedJSONPublisher() {
+    if (generation) munmap(generation, sizeof(uint64_t));
+}
+
+EJSON_INLINE uint64_t SharedJSONPublisher::publish(const JSON& doc) {
+    std::string frozen = doc.freeze();
+    // Claim a generation no other publisher holds: its segment must be new.
+    uint64_t next = generation->load(std::memory_order_acquire) + 1;
+    std::string segment = detail::shm_segment_name(name, next);
+    int fd;
+    while ((fd = shm_open(segment.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644)) < 0 && errno == EEXIST) {
+        segment = detail::shm_segment_name(name, ++next);
+    }
+    if (fd < 0) throw JSONParseError("Cannot create shared memory: " + segment);
+    if (ftruncate(fd, static_cast<off_t>(frozen.size())) != 0) {
+        close(fd);
+        shm_unlink(segment.c_str());
+        throw JSONParseError("Cannot size shared memory: " + segment);
+    }
+    void* mem = mmap(nullptr, frozen.size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(segment.c_str());
+        throw JSONParseError("Cannot map shared memory: " + segment);
+    }
+    std::memcpy(mem, frozen.data(), frozen.size());
+    munmap(mem, frozen.size());
+    // Only move the generation forward; a newer publish supersedes this one.
+    uint64_t previous = generation->load(std::memory_order_acquire);
+    while (previous < next && !generation->compare_exchange_weak(previous, next, std::memory_order_acq_rel)) {
+    }
+    if (previous > next) {
+        shm_unlink(segment.c_str());
+        return previous;
+    }
+    if (previous != 0) shm_unlink(detail::shm_segment_name(name, previous).c_str());
+    return next;
+}
+
+EJSON_INLINE void SharedJSONPublisher::unlink() {
+    uint64_t current = generation->load(std::memory_order_acquire);
+    if (current != 0) shm_unlink(detail::shm_segment_name(name, current).c_str());
+    shm_unlink(name.c_str());
+}
+
+EJSON_INLINE SharedJSONReader::SharedJSONReader(const std::string& name) : name(detail::shm_name(name)) {
+    int fd = shm_open(this->name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw JSONParseError("Cannot open shared memory: " + this->name);
+    void* mem = mmap(nullptr, sizeof(uint64_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) throw JSONParseError("Cannot map shared memory: " + this->name);
+    control = static_cast<const std::atomic<uint64_t>*>(mem);
+    if (!refresh()) throw JSONParseError("No document published under: " + this->name);
+}
+
+EJSON_INLINE SharedJSONReader::~SharedJSONReader() {
+    if (data) munmap(const_cast<char*>(data), size);
+    if (control) munmap(const_cast<std::atomic<uint64_t>*>(control), sizeof(uint64_t));
+}
+
+EJSON_INLINE bool SharedJSONReader::refresh() {
+    // A publisher may unlink the segment between reading the generation and
+    // opening it; retry with the newer generation in that case.
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        uint64_t current = control->load(std::memory_order_acquire);
+        if (current == 0 || current == mapped_generation) return false;
+        int fd = shm_open(detail::shm_segment_name(name, current).c_str(), O_RDONLY, 0);
+        if (fd < 0) continue;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            continue;
+        }
+        void* mem = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) throw JSONParseError("Cannot map shared memory: " + name);
+        if (data) munmap(const_cast<char*>(data), size);
+        data = static_cast<const char*>(mem);
+        size = static_cast<size_t>(st.st_size);
+        mapped_generation = current;
+        return true;
+    }
+    throw JSONParseError("Shared document kept changing while mapping: " + name);
+}
+#endif
+
+#if defined(EJSON_COMPILED)
+template bool JSON::get<bool>() const;
+template int JSON::get<int>() const;
+template long long JSON::get<long long>() const;
+template float JSON::get<float>() const;
+template double JSON::get<double>() const;
+template std::string JSON::get<std::string>() const;
+template bool JSON::get_or<bool>(const bool&) const;
+template int JSON::get_or<int>(const int&) const;
+template long long JSON::get_or<long long>(const long long&) const;
+template float JSON::get_or<float>(const float&) const;
+template double JSON::get_or<double>(const double&) const;
+template std::string JSON::get_or<std::string>(const std::string&) const;
+#endif
+
+} // namespace ejson
+#endif // !EJSON_COMPILED || EJSON_IMPLEMENTATION
 
 
 // coffee 😀  =  +254741593506
\ No newline at end of file
@@ -19,6 +19,92 @@
 #include <fstream>
 #include <algorithm>
 #include <initializer_list>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
+#include <tuple>
+#include <type_traits>
+#include <future>
+#include <thread>
+
+// ============ BUILD MODES ============
+// By default e-xml is header-only and every function below is inline.
+// To compile the parser, serializer and file I/O only once, define
+// EXML_COMPILED for every translation unit (e.g. -DEXML_COMPILED) and define
+// EXML_IMPLEMENTATION before including this header in exactly one .cpp file.
+#if defined(EXML_COMPILED)
+#define EXML_INLINE
+#else
+#define EXML_INLINE inline
+#endif
+
+// ============ TRACEPOINTS ============
+// Building with EXML_ENABLE_USDT (Linux, GCC/Clang, x86-64 or AArch64) embeds
+// USDT probes under provider "exml" for perf/bpftrace, with no systemtap
+// headers required:
+//   parse_start(bytes)         parse_done(bytes, ns)
+//   dump_start(pretty)         dump_done(bytes, ns)
+//   from_file_start(path)      from_file_done(bytes, ns)
+//   to_file_start(path)        to_file_done(bytes, ns)
+// e.g. bpftrace -e 'usdt:./server:exml:parse_done { @ns = hist(arg1); }'
+// Every probe site is a single nop. Durations are only measured while a
+// *_done probe is attached (its semaphore is non-zero). Without
+// EXML_ENABLE_USDT all of this compiles away.
+#if defined(EXML_ENABLE_USDT) && defined(__linux__) && defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+#include <chrono>
+#define EXML_USDT_NOTE(probe, semaphore, args) \
+    "990: nop\n" \
+    ".pushsection .note.stapsdt,\"?\",\"note\"\n" \
+    ".balign 4\n" \
+    ".4byte 992f-991f, 994f-993f, 3\n" \
+    "991: .asciz \"stapsdt\"\n" \
+    "992: .balign 4\n" \
+    "993: .8byte 990b\n" \
+    ".8byte _.stapsdt.base\n" \
+    ".8byte " semaphore "\n" \
+    ".asciz \"exml\"\n" \
+    ".asciz \"" #probe "\"\n" \
+    ".asciz \"" args "\"\n" \
+    "994: .balign 4\n" \
+    ".popsection\n" \
+    ".ifndef _.stapsdt.base\n" \
+    ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n" \
+    ".weak _.stapsdt.base\n" \
+    ".hidden _.stapsdt.base\n" \
+    "_.stapsdt.base: .space 1\n" \
+    ".size _.stapsdt.base, 1\n" \
+    ".popsection\n" \
+    ".endif\n"
+#define EXML_USDT_SEMAPHORE(probe) exml_##probe##_done_semaphore
+#define EXML_USDT_DEFINE_SEMAPHORE(probe) \
+    inline volatile unsigned short EXML_USDT_SEMAPHORE(probe) \
+        __asm__("exml_" #probe "_done_semaphore") __attribute__((section(".probes"), used)) = 0;
+EXML_USDT_DEFINE_SEMAPHORE(parse)
+EXML_USDT_DEFINE_SEMAPHORE(dump)
+EXML_USDT_DEFINE_SEMAPHORE(from_file)
+EXML_USDT_DEFINE_SEMAPHORE(to_file)
+// Fires <probe>_start(arg) and starts the clock if <probe>_done is being traced.
+#define EXML_TRACE_BEGIN(probe, arg) \
+    __asm__ __volatile__(EXML_USDT_NOTE(probe##_start, "0", "8@%0") :: "nor"((unsigned long long)(arg))); \
+    const auto exml_trace_start_ = EXML_USDT_SEMAPHORE(probe) ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()
+// Fires <probe>_done(bytes, elapsed_ns) when it is being traced.
+#define EXML_TRACE_END(probe, bytes) \
+    do { \
+        if (EXML_USDT_SEMAPHORE(probe)) { \
+            long long exml_trace_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - exml_trace_start_).count(); \
+            __asm__ __volatile__(EXML_USDT_NOTE(probe##_done, "exml_" #probe "_done_semaphore", "8@%0 -8@%1") \
+                                 :: "nor"((unsigned long long)(bytes)), "nor"(exml_trace_ns_)); \
+        } \
+    } while (0)
+#else
+#define EXML_TRACE_BEGIN(probe, arg) ((void)0)
+#define EXML_TRACE_END(probe, bytes) ((void)0)
+#endif
 
 namespace exml {
 
@@ -26,6 +112,62 @@ struct XMLParseError : std::runtime_error {
     XMLParseError(const std::string& msg) : std::runtime_error("XML Parse Error: " + msg) {}
 };
 
+// ============ BASE64 ============
+// Encodes bytes as standard, padded base64.
+EXML_INLINE std::string base64_encode(const unsigned char* data, size_t len);
+EXML_INLINE std::string base64_encode(const std::vector<unsigned char>& bytes);
+
+// Decodes base64 text and appends the bytes to out. Whitespace is skipped and
+// trailing padding is optional. Works directly on any character span.
+EXML_INLINE void base64_decode(const char* data, size_t len, std::vector<unsigned char>& out);
+
+namespace detail {
+    // Gzip detection and decoding used by from_file(). gunzip() throws once the
+    // inflated payload would exceed max_size bytes.
+    constexpr size_t default_max_inflated_size = size_t(1) << 30;   // 1 GiB
+    EXML_INLINE bool is_gzip(std::istream& in);
+    EXML_INLINE void gunzip(std::istream& in, std::string& out, size_t max_size = default_max_inflated_size);
+
+    // "true"/"1" and "false"/"0", case-insensitively; anything else yields default_val.
+    inline bool text_to_bool(const std::string& text, bool default_val) {
+        std::string lower_text = text;
+        std::transform(lower_text.begin(), lower_text.end(), lower_text.begin(), ::tolower);
+        if (lower_text == "true" || lower_text == "1") return true;
+        if (lower_text == "false" || lower_text == "0") return false;
+        return default_val;
+    }
+}
+
+// ============ PARSE OPTIONS ============
+struct ParseOptions {
+    // Expand entities declared in the DOCTYPE internal subset. Expansions are
+    // computed once per document and reused; references inside replacement
+    // text are expanded too, but markup in it is kept as text.
+    bool expand_entities = true;
+    size_t max_entity_depth = 8;             // nesting of entity references
+    size_t max_entity_expansion = 1 << 20;   // bytes produced by entity expansion per document
+    size_t max_entities = 1024;              // declarations per document
+
+    // When non-empty, only elements on these paths are materialized, together
+    // with their ancestors (name and attributes only). "/feed/entry/title" is
+    // anchored at the root, "title" or "entry/title" match at any depth, "*"
+    // matches any one name, and a trailing "@id" step keeps elements that
+    // carry that attribute. Subtrees no path can reach are skipped by tag
+    // counting without copying; they are checked for balance only. Relative
+    // paths cost one extra such pass over the document to find the subtrees
+    // holding an element they end on; one ending in "*" reaches everything.
+    std::vector<std::string> select;
+
+    // Keep each start tag's raw attribute text and decode it on demand.
+    // has_attribute() and attribute() scan the raw text; set_attribute(),
+    // remove_attribute() and load_attributes() materialize it into
+    // `attributes`, which stays empty until then. Documents that declare
+    // entities are parsed eagerly.
+    bool lazy_attributes = false;
+};
+
+class FrozenDocument;
+
 struct Node {
     std::string name;
     std::string text_content;
@@ -45,10 +187,12 @@ struct Node {
 
     // ============ ATTRIBUTE OPERATIONS ============
     bool has_attribute(const std::string& key) const {
+        if (pending.raw) return find_pending_attribute(key).has_value();
         return attributes.count(key);
     }
 
     std::optional<std::string> attribute(const std::string& key) const {
+        if (pending.raw) return find_pending_attribute(key);
         auto it = attributes.find(key);
         if (it != attributes.end()) {
             return it->second;
@@ -61,14 +205,34 @@ struct Node {
     }
 
     Node& set_attribute(const std::string& key, const std::string& value) {
-        attributes[key] = value;
+        load_attributes()[key] = value;
         return *this;
     }
 
     Node& remove_attribute(const std::string& key) {
-        attributes.erase(key);
+        load_attributes().erase(key);
         return *this;
     }
+
+    // Decodes attributes left pending by ParseOptions::lazy_attributes into
+    // `attributes` and returns them.
+    std::map<std::string, std::string>& load_attributes();
+
+    // Counts pending attributes by their names, without decoding values.
+    size_t attribute_count() const {
+        return pending.raw ? pending_attribute_count() : attributes.size();
+    }
+
+    // Visits attributes in key order without materializing pending ones,
+    // decoding them once per call.
+    template<typename F>
+    void for_each_attribute(F&& f) const {
+        if (!pending.raw) {
+            for (const auto& [k, v] : attributes) f(k, v);
+            return;
+        }
+        for (const auto& [k, v] : pending_attribute_map()) f(k, v);
+    }
     
     // ============ TEXT CONTENT OPERATIONS ============
     const std::string& text() const { return text_content; }
@@ -87,13 +251,20 @@ struct Node {
     }
     int as_int(int default_val = 0) const { return as<int>(default_val); }
     double as_double(double default_val = 0.0) const { return as<double>(default_val); }
-    bool as_bool(bool default_val = false) const {
-        std::string lower_text = text_content;
-        std::transform(lower_text.begin(), lower_text.end(), lower_text.begin(), ::tolower);
-        if (lower_text == "true" || lower_text == "1") return true;
-        if (lower_text == "false" || lower_text == "0") return false;
-        return default_val;
+    bool as_bool(bool default_val = false) const { return detail::text_to_bool(text_content, default_val); }
+
+    // Decodes base64 text content (line breaks allowed) into raw bytes.
+    std::vector<unsigned char> as_base64_bytes() const {
+        std::vector<unsigned char> bytes;
+        base64_decode(text_content.data(), text_content.size(), bytes);
+        return bytes;
+    }
+
+    Node& set_base64(const unsigned char* data, size_t len) {
+        text_content = base64_encode(data, len);
+        return *this;
     }
+    Node& set_base64(const std::vector<unsigned char>& bytes) { return set_base64(bytes.data(), bytes.size()); }
 
     // ============ CHILD NODE OPERATIONS ============
     // Add a child node
@@ -156,222 +327,2279 @@ struct Node {
     void clear() {
         text_content.clear();
         attributes.clear();
+        pending.raw.reset();
         child_nodes.clear();
     }
 
     // ============ SERIALIZATION ============
-    std::string dump(bool pretty = true, int indent_level = 0, int indent_size = 2) const {
-        std::ostringstream oss;
-        dump_recursive(oss, pretty, indent_level, indent_size);
-        return oss.str();
-    }
+    std::string dump(bool pretty = true, int indent_level = 0, int indent_size = 2) const;
 
     // ============ PARSING ============
-    static Node parse(const std::string& s) {
-        size_t idx = 0;
-        skip_ws_and_prolog(s, idx);
-        Node root = parse_node(s, idx);
-        skip_ws(s, idx);
-        if (idx < s.size()) {
-            throw XMLParseError("Extra characters after root element at position " + std::to_string(idx));
+    static Node parse(const std::string& s);
+    static Node parse(const std::string& s, const ParseOptions& options);
+
+    // ============ FILE I/O ============
+    // Gzip-compressed files (.gz) are detected by their magic bytes and inflated transparently.
+    // Inflation stops with an error past max_inflated_size bytes, guarding against gzip bombs.
+    static Node from_file(const std::string& filename, size_t max_inflated_size = detail::default_max_inflated_size);
+
+    void to_file(const std::string& filename, bool pretty = true) const;
+
+    // ============ BINARY ENCODING ============
+    // Compact binary form for service-to-service traffic. Element and
+    // attribute names go through a dictionary, lengths and counts are varints,
+    // and short attribute values and texts seen before are sent as references
+    // into a table both sides build as they go.
+    std::string to_binary() const;
+    static Node from_binary(const char* data, size_t len);
+    static Node from_binary(const std::string& bytes) { return from_binary(bytes.data(), bytes.size()); }
+
+    // ============ FREEZING ============
+    // Immutable, flattened copy for read-heavy workloads (see FrozenDocument).
+    FrozenDocument freeze() const;
+
+private:
+    // Raw attribute text of the start tag, kept by ParseOptions::lazy_attributes.
+    // Held out of line so eagerly parsed nodes only pay for a null pointer.
+    struct PendingAttributes {
+        std::unique_ptr<std::string> raw;
+        PendingAttributes() = default;
+        PendingAttributes(const PendingAttributes& other) : raw(other.raw ? std::make_unique<std::string>(*other.raw) : nullptr) {}
+        PendingAttributes(PendingAttributes&&) noexcept = default;
+        PendingAttributes& operator=(const PendingAttributes& other) {
+            raw = other.raw ? std::make_unique<std::string>(*other.raw) : nullptr;
+            return *this;
+        }
+        PendingAttributes& operator=(PendingAttributes&&) noexcept = default;
+    };
+
+    PendingAttributes pending;
+
+    static bool next_pending_attribute(const std::string& raw, size_t& i, std::string_view& key, std::string_view& value);
+    std::optional<std::string> find_pending_attribute(const std::string& key) const;
+    size_t pending_attribute_count() const;
+    std::map<std::string, std::string> pending_attribute_map() const;
+
+    // ============ PARSER IMPLEMENTATION ============
+    static void skip_ws(const std::string& s, size_t& idx);
+    
+    // Per-document parser state: options and the internal entity table.
+    struct ParseContext;
+
+    static void skip_ws_and_prolog(const std::string& s, size_t& idx, ParseContext& ctx);
+
+    static void parse_doctype(const std::string& s, size_t& idx, ParseContext& ctx);
+
+    static std::string parse_entity(const std::string& entity, ParseContext& ctx, size_t depth);
+    
+    static std::string decode_text(const std::string& text, ParseContext& ctx, size_t depth = 0);
+
+    static Node parse_node(const std::string& s, size_t& idx, ParseContext& ctx);
+
+    static void parse_attributes(const std::string& s, size_t& idx, Node& node, ParseContext& ctx);
+
+    // Validates attribute syntax without copying; returns whether any were found.
+    static bool skip_attributes(const std::string& s, size_t& idx);
+
+    // Path-filtered parsing for ParseOptions::select. Returns whether the
+    // element was kept; path holds the names of the open elements.
+    static bool parse_selected(const std::string& s, size_t& idx, ParseContext& ctx,
+                               std::vector<std::string_view>& path, Node& out);
+
+    static bool skip_markup(const std::string& s, size_t& idx);
+
+    static void skip_element_content(const std::string& s, size_t& idx);
+    
+    // ============ SERIALIZER IMPLEMENTATION ============
+    static std::string encode_text(const std::string& text);
+
+    void dump_recursive(std::ostringstream& oss, bool pretty, int indent_level, int indent_size) const;
+};
+
+// ============ WELL-FORMEDNESS CHECK ============
+// Result of is_well_formed(): an error code and the byte offset it was found at.
+struct WellFormedness {
+    enum Code {
+        Ok,
+        UnexpectedEnd,       // input ended inside markup or with open elements
+        NoRoot,              // no root element
+        ContentOutsideRoot,  // text or a second element outside the root
+        InvalidName,         // malformed element or attribute name
+        MismatchedTag,       // closing tag does not match the open element
+        BadAttribute,        // missing '=', unquoted value or '<' in a value
+        DuplicateAttribute,
+        BadEntity,           // malformed or undeclared entity/character reference
+        BadMarkup,           // malformed comment, CDATA, PI or DOCTYPE
+        TooDeep              // nesting beyond max_depth
+    };
+
+    Code code = Ok;
+    size_t offset = 0;
+
+    static constexpr size_t max_depth = 256;
+    static constexpr size_t max_attributes = 64;  // duplicates are checked among the first 64
+
+    explicit operator bool() const { return code == Ok; }
+};
+
+// Checks tag nesting, attribute syntax and entity references without
+// building a tree, allocating or throwing. Open element names are kept as
+// offsets into the input and compared byte for byte against closing tags.
+// Named entities other than the five predefined ones are accepted only when
+// the document has a DOCTYPE.
+EXML_INLINE WellFormedness is_well_formed(std::string_view xml);
+
+// ============ SHAPE PROFILING ============
+// Aggregates structural statistics over a corpus of documents: nesting depth,
+// child and attribute counts, element and attribute name frequencies, text
+// lengths, repeated short text values and the children seen under each
+// element path. report() summarizes them as a <shape-profile> document.
+class ShapeProfile {
+public:
+    // Power-of-two histogram: bucket 0 counts zeros, bucket b counts [2^(b-1), 2^b).
+    struct Histogram {
+        std::array<size_t, 65> buckets{};
+        size_t count = 0;
+        size_t max = 0;
+        double total = 0;
+
+        void add(size_t n);
+        void merge(const Histogram& other);
+        // Upper bound of the bucket holding the p-th fraction of samples.
+        size_t percentile(double p) const;
+        Node to_node(const std::string& name) const;
+    };
+
+    void add(const Node& doc);
+    // Profiles one document per file, gzip-aware like Node::from_file().
+    void add_file(const std::string& path);
+    void merge(const ShapeProfile& other);
+
+    // Profiles files on several threads and merges the results.
+    static ShapeProfile profile_files(const std::vector<std::string>& paths, unsigned threads = 0);
+
+    size_t documents() const { return docs; }
+    Node report() const;
+
+    // Bounds on distinct text values and element paths tracked per profile.
+    static constexpr size_t max_tracked_values = 4096;
+    static constexpr size_t max_tracked_paths = 4096;
+    static constexpr size_t max_value_length = 32;
+
+private:
+    size_t docs = 0;
+    size_t elements = 0;
+    Histogram depths, child_counts, attribute_counts, text_lengths;
+    std::map<std::string, size_t> element_names;
+    std::map<std::string, size_t> attribute_names;
+    std::map<std::string, size_t> value_counts;  // text and attribute values up to max_value_length
+    std::map<std::string, size_t> path_counts;
+
+    void count_value(const std::string& value);
+    void walk(const Node& node, size_t depth, std::string& path, size_t& max_depth);
+};
+
+// ============ FROZEN DOCUMENTS ============
+// Read-only copy of a tree laid out in document order. Each element gets a
+// preorder and postorder number, so ancestor tests are two comparisons and a
+// subtree is the contiguous range [pre, subtree_end]. Element names are
+// interned and every name keeps a sorted posting list of its elements, which
+// turns descendant queries into two binary searches. Nothing is computed
+// lazily, so any number of threads may read a FrozenDocument concurrently.
+class FrozenNode {
+public:
+    FrozenNode() = default;
+
+    explicit operator bool() const { return doc != nullptr; }
+    uint32_t pre() const { return id; }
+    uint32_t post() const;
+    uint32_t subtree_end() const;  // preorder number of the last descendant
+
+    std::string_view name() const;
+    std::string_view text() const;
+    size_t attribute_count() const;
+    std::optional<std::string_view> attribute(std::string_view key) const;
+
+    FrozenNode parent() const;
+    FrozenNode first_child() const;
+    FrozenNode next_sibling() const;
+    // First direct child with the given name, or an empty FrozenNode.
+    FrozenNode child(std::string_view child_name) const;
+    std::vector<FrozenNode> children(std::string_view child_name) const;
+    // Descendants with the given name, in document order.
+    std::vector<FrozenNode> descendants(std::string_view descendant_name) const;
+
+    bool is_ancestor_of(const FrozenNode& other) const;
+    bool operator==(const FrozenNode& other) const { return doc == other.doc && id == other.id; }
+    bool operator!=(const FrozenNode& other) const { return !(*this == other); }
+
+    // Copies the subtree back into a mutable Node.
+    Node to_node() const;
+
+private:
+    friend class FrozenDocument;
+    FrozenNode(const FrozenDocument* doc, uint32_t id) : doc(doc), id(id) {}
+
+    const FrozenDocument* doc = nullptr;
+    uint32_t id = 0;
+};
+
+class FrozenDocument {
+public:
+    static constexpr uint32_t npos = UINT32_MAX;
+
+    FrozenDocument() = default;
+    explicit FrozenDocument(const Node& root);
+
+    size_t size() const { return entries.size(); }
+    FrozenNode root() const { return entries.empty() ? FrozenNode() : FrozenNode(this, 0); }
+    FrozenNode node(uint32_t pre) const { return pre < entries.size() ? FrozenNode(this, pre) : FrozenNode(); }
+    // Every element with the given name (//name), in document order.
+    std::vector<FrozenNode> find_all(std::string_view element_name) const;
+    size_t count(std::string_view element_name) const;
+
+private:
+    friend class FrozenNode;
+
+    struct Entry {
+        uint32_t name;
+        uint32_t parent;
+        uint32_t first_child;
+        uint32_t next_sibling;
+        uint32_t subtree_end;
+        uint32_t post;
+        uint32_t attr_begin;
+        uint32_t attr_end;
+    };
+
+    std::vector<Entry> entries;                                 // indexed by preorder number
+    std::vector<std::string> texts;                             // indexed by preorder number
+    std::vector<std::pair<std::string, std::string>> attrs;     // sorted by key within each element
+    std::vector<std::string> names;
+    std::map<std::string, uint32_t, std::less<>> name_ids;
+    std::vector<std::vector<uint32_t>> postings;                // per name id, ascending preorder
+
+    uint32_t intern(const std::string& element_name);
+    uint32_t lookup(std::string_view element_name) const;
+    uint32_t add(const Node& node, uint32_t parent, uint32_t& post_counter);
+    std::vector<FrozenNode> collect(uint32_t name_id, uint32_t first, uint32_t last) const;
+};
+
+// ============ STRUCT BINDING ============
+// Maps C++ structs to elements declaratively, e.g.
+//   struct Item { std::string sku; int qty = 0; };
+//   struct Order { long id = 0; std::vector<Item> items; std::optional<std::string> note; };
+//   EXML_BINDING(Item, "item", exml::attribute("sku", &Item::sku), exml::text(&Item::qty))
+//   EXML_BINDING(Order, "order", exml::attribute("id", &Order::id),
+//                exml::elements("item", &Order::items), exml::element("note", &Order::note))
+//   Order o = exml::parse_as<Order>(xml);   std::string back = exml::dump_as(o);
+// Members may be strings, bool, arithmetic types, other bound structs,
+// std::optional of those, and std::vector of those for elements(). Children
+// are matched in one pass over the element; numbers use std::from_chars /
+// strtod; bools follow Node::as_bool(). Absent attributes and elements leave
+// members unchanged. The macro specializes exml::Binding, so it must be used
+// at global namespace scope.
+template<typename T>
+struct Binding;
+
+#define EXML_BINDING(Type, element_name, ...)                              \
+    template<> struct exml::Binding<Type> {                                 \
+        static constexpr const char* name = element_name;                  \
+        static auto fields() { return std::make_tuple(__VA_ARGS__); }       \
+    };
+
+enum class FieldKind { Attribute, Element, Elements, Text };
+
+template<typename T, typename M, FieldKind K>
+struct FieldBinding {
+    const char* name;
+    M T::*member;
+};
+
+template<typename T, typename M>
+constexpr FieldBinding<T, M, FieldKind::Attribute> attribute(const char* name, M T::*member) { return {name, member}; }
+
+template<typename T, typename M>
+constexpr FieldBinding<T, M, FieldKind::Element> element(const char* name, M T::*member) { return {name, member}; }
+
+// Every child element with this name, appended to a std::vector member.
+template<typename T, typename M>
+constexpr FieldBinding<T, M, FieldKind::Elements> elements(const char* name, M T::*member) { return {name, member}; }
+
+// The element's own text content.
+template<typename T, typename M>
+constexpr FieldBinding<T, M, FieldKind::Text> text(M T::*member) { return {"", member}; }
+
+namespace detail {
+    template<typename U, typename = void>
+    struct is_bound : std::false_type {};
+    template<typename U>
+    struct is_bound<U, std::void_t<decltype(Binding<U>::fields())>> : std::true_type {};
+
+    template<typename U> struct is_optional : std::false_type {};
+    template<typename U> struct is_optional<std::optional<U>> : std::true_type {};
+
+    template<typename U>
+    void from_text(const std::string& text, U& out) {
+        if constexpr (std::is_same_v<U, std::string>) {
+            out = text;
+        } else if constexpr (std::is_same_v<U, bool>) {
+            out = text_to_bool(text, out);
+        } else if constexpr (std::is_integral_v<U>) {
+            const char* first = text.data();
+            const char* last = first + text.size();
+            while (first < last && std::isspace(static_cast<unsigned char>(*first))) ++first;
+            if (first < last && *first == '+') ++first;
+            U v{};
+            if (std::from_chars(first, last, v).ec == std::errc()) out = v;
+        } else if constexpr (std::is_floating_point_v<U>) {
+            char* end = nullptr;
+            double v = std::strtod(text.c_str(), &end);
+            if (end != text.c_str()) out = static_cast<U>(v);
+        } else {
+            static_assert(std::is_same_v<U, void>, "Unsupported member type for XML binding");
         }
-        return root;
     }
 
-    // ============ FILE I/O ============
-    static Node from_file(const std::string& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            throw XMLParseError("Cannot open file: " + filename);
+    template<typename U>
+    std::string to_text(const U& value) {
+        if constexpr (std::is_same_v<U, std::string>) {
+            return value;
+        } else if constexpr (std::is_same_v<U, bool>) {
+            return value ? "true" : "false";
+        } else if constexpr (std::is_integral_v<U>) {
+            return std::to_string(value);
+        } else if constexpr (std::is_floating_point_v<U>) {
+            // Shortest of 15 or 17 significant digits that reads back exactly.
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.15g", static_cast<double>(value));
+            if (static_cast<U>(std::strtod(buf, nullptr)) != value) std::snprintf(buf, sizeof(buf), "%.17g", static_cast<double>(value));
+            return buf;
+        } else {
+            static_assert(std::is_same_v<U, void>, "Unsupported member type for XML binding");
+        }
+    }
+
+    template<typename T>
+    void read_fields(const Node& node, T& out);
+    template<typename T>
+    void write_fields(const T& value, Node& node);
+
+    template<typename U>
+    void read_value(const Node& node, U& out) {
+        if constexpr (is_optional<U>::value) {
+            typename U::value_type v{};
+            read_value(node, v);
+            out = std::move(v);
+        } else if constexpr (is_bound<U>::value) {
+            read_fields(node, out);
+        } else {
+            from_text(node.text_content, out);
         }
-        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-        return parse(content);
     }
 
-    void to_file(const std::string& filename, bool pretty = true) const {
-        std::ofstream file(filename);
-        if (!file.is_open()) {
-            throw XMLParseError("Cannot write to file: " + filename);
+    template<typename U>
+    void write_value(const U& value, Node& node) {
+        if constexpr (is_bound<U>::value) write_fields(value, node);
+        else node.text_content = to_text(value);
+    }
+
+    template<typename U>
+    void read_attribute(const std::string& text, U& out) {
+        if constexpr (is_optional<U>::value) {
+            typename U::value_type v{};
+            from_text(text, v);
+            out = std::move(v);
+        } else {
+            from_text(text, out);
         }
-        file << dump(pretty);
     }
 
-private:
-    // ============ PARSER IMPLEMENTATION ============
-    static void skip_ws(const std::string& s, size_t& idx) {
-        while (idx < s.size() && std::isspace(s[idx])) idx++;
+    // Returns true if child was consumed by this field.
+    template<typename T, typename M, FieldKind K>
+    bool read_child(const FieldBinding<T, M, K>& field, const Node& child, T& out) {
+        if constexpr (K == FieldKind::Element) {
+            if (child.name != field.name) return false;
+            read_value(child, out.*field.member);
+            return true;
+        } else if constexpr (K == FieldKind::Elements) {
+            if (child.name != field.name) return false;
+            typename M::value_type item{};
+            read_value(child, item);
+            (out.*field.member).push_back(std::move(item));
+            return true;
+        } else {
+            return false;
+        }
     }
-    
-    static void skip_ws_and_prolog(const std::string& s, size_t& idx) {
-        while (idx < s.size()) {
-            skip_ws(s, idx);
-            if (idx + 1 >= s.size() || s[idx] != '<') break;
-            if (s[idx+1] == '?' || s[idx+1] == '!') {
-                 auto end_pos = s.find('>', idx);
-                 if (end_pos == std::string::npos) throw XMLParseError("Unclosed prolog/comment");
-                 idx = end_pos + 1;
-            } else {
-                break;
+
+    template<typename T, typename M, FieldKind K>
+    void read_own(const FieldBinding<T, M, K>& field, const Node& node, T& out) {
+        if constexpr (K == FieldKind::Attribute) {
+            if (auto value = node.attribute(field.name)) read_attribute(*value, out.*field.member);
+        } else if constexpr (K == FieldKind::Text) {
+            read_attribute(node.text_content, out.*field.member);
+        }
+    }
+
+    template<typename T, typename M, FieldKind K>
+    void write_field(const FieldBinding<T, M, K>& field, const T& value, Node& node) {
+        const M& member = value.*field.member;
+        if constexpr (K == FieldKind::Elements) {
+            for (const auto& item : member) {
+                Node child(field.name);
+                write_value(item, child);
+                node.add_child(std::move(child));
             }
+        } else if constexpr (is_optional<M>::value) {
+            if (!member) return;
+            if constexpr (K == FieldKind::Attribute) node.set_attribute(field.name, to_text(*member));
+            else if constexpr (K == FieldKind::Text) node.text_content = to_text(*member);
+            else {
+                Node child(field.name);
+                write_value(*member, child);
+                node.add_child(std::move(child));
+            }
+        } else if constexpr (K == FieldKind::Attribute) {
+            node.set_attribute(field.name, to_text(member));
+        } else if constexpr (K == FieldKind::Text) {
+            node.text_content = to_text(member);
+        } else {
+            Node child(field.name);
+            write_value(member, child);
+            node.add_child(std::move(child));
         }
     }
 
-    static std::string parse_entity(const std::string& entity) {
-        if (entity == "lt") return "<";
-        if (entity == "gt") return ">";
-        if (entity == "amp") return "&";
-        if (entity == "quot") return "\"";
-        if (entity == "apos") return "'";
-        return "&" + entity + ";";
+    template<typename T>
+    void read_fields(const Node& node, T& out) {
+        const auto fields = Binding<T>::fields();
+        std::apply([&](const auto&... field) { (read_own(field, node, out), ...); }, fields);
+        for (const auto& child : node.child_nodes) {
+            std::apply([&](const auto&... field) { (void)(read_child(field, child, out) || ...); }, fields);
+        }
     }
-    
-    static std::string decode_text(const std::string& text) {
-        std::string decoded;
-        size_t i = 0;
-        while (i < text.length()) {
-            if (text[i] == '&') {
-                size_t semi_pos = text.find(';', i);
-                if (semi_pos != std::string::npos) {
-                    std::string entity = text.substr(i + 1, semi_pos - i - 1);
-                    decoded += parse_entity(entity);
-                    i = semi_pos + 1;
-                } else {
-                    decoded += '&'; // Malformed entity
-                    i++;
+
+    template<typename T>
+    void write_fields(const T& value, Node& node) {
+        const auto fields = Binding<T>::fields();
+        std::apply([&](const auto&... field) { (write_field(field, value, node), ...); }, fields);
+    }
+}
+
+// Fills a bound struct from an element; throws if the element name differs.
+template<typename T>
+void from_node(const Node& node, T& out) {
+    if (node.name != Binding<T>::name) throw XMLParseError("Expected <" + std::string(Binding<T>::name) + ">, got <" + node.name + ">");
+    detail::read_fields(node, out);
+}
+
+template<typename T>
+T from_node(const Node& node) {
+    T out{};
+    from_node(node, out);
+    return out;
+}
+
+template<typename T>
+Node to_node(const T& value) {
+    Node node(Binding<T>::name);
+    detail::write_fields(value, node);
+    return node;
+}
+
+template<typename T>
+T parse_as(const std::string& xml) {
+    return from_node<T>(Node::parse(xml));
+}
+
+template<typename T>
+std::string dump_as(const T& value, bool pretty = true) {
+    return to_node(value).dump(pretty);
+}
+
+#if defined(EXML_COMPILED) && !defined(EXML_IMPLEMENTATION)
+// Common conversions are instantiated once, in the implementation file.
+extern template int Node::as<int>(int) const;
+extern template long Node::as<long>(long) const;
+extern template long long Node::as<long long>(long long) const;
+extern template float Node::as<float>(float) const;
+extern template double Node::as<double>(double) const;
+extern template std::string Node::as<std::string>(std::string) const;
+#endif
+
+} // namespace exml
+
+// ============ IMPLEMENTATION ============
+#if !defined(EXML_COMPILED) || defined(EXML_IMPLEMENTATION)
+namespace exml {
+
+// ============ BASE64 ============
+namespace detail {
+    inline constexpr char base64_alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    // Decode table values: 0-63 sextet, 64 padding, 65 whitespace, 255 invalid.
+    struct Base64Table {
+        unsigned char v[256];
+        constexpr Base64Table() : v() {
+            for (int i = 0; i < 256; ++i) v[i] = 255;
+            for (int i = 0; i < 64; ++i) v[static_cast<unsigned char>(base64_alphabet[i])] = static_cast<unsigned char>(i);
+            v[static_cast<unsigned char>('=')] = 64;
+            v[static_cast<unsigned char>(' ')] = v[static_cast<unsigned char>('\n')] = 65;
+            v[static_cast<unsigned char>('\r')] = v[static_cast<unsigned char>('\t')] = 65;
+        }
+    };
+    inline constexpr Base64Table base64_table{};
+}
+
+EXML_INLINE std::string base64_encode(const unsigned char* data, size_t len) {
+    std::string out((len + 2) / 3 * 4, '=');
+    char* o = &out[0];
+    size_t i = 0;
+    for (; i + 3 <= len; i += 3, o += 4) {
+        unsigned n = (unsigned(data[i]) << 16) | (unsigned(data[i + 1]) << 8) | data[i + 2];
+        o[0] = detail::base64_alphabet[n >> 18];
+        o[1] = detail::base64_alphabet[(n >> 12) & 63];
+        o[2] = detail::base64_alphabet[(n >> 6) & 63];
+        o[3] = detail::base64_alphabet[n & 63];
+    }
+    if (i < len) {
+        unsigned n = unsigned(data[i]) << 16;
+        if (i + 1 < len) n |= unsigned(data[i + 1]) << 8;
+        o[0] = detail::base64_alphabet[n >> 18];
+        o[1] = detail::base64_alphabet[(n >> 12) & 63];
+        if (i + 1 < len) o[2] = detail::base64_alphabet[(n >> 6) & 63];
+    }
+    return out;
+}
+
+EXML_INLINE std::string base64_encode(const std::vector<unsigned char>& bytes) {
+    return base64_encode(bytes.data(), bytes.size());
+}
+
+EXML_INLINE void base64_decode(const char* data, size_t len, std::vector<unsigned char>& out) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(data);
+    const auto& t = detail::base64_table.v;
+    out.reserve(out.size() + len / 4 * 3);
+    size_t i = 0;
+    unsigned quad = 0;
+    int count = 0, padding = 0;
+    while (i < len) {
+        // Fast path: whole groups of four alphabet characters.
+        if (count == 0) {
+            while (i + 4 <= len) {
+                unsigned a = t[in[i]], b = t[in[i + 1]], c = t[in[i + 2]], d = t[in[i + 3]];
+                if ((a | b | c | d) >= 64) break;
+                unsigned n = (a << 18) | (b << 12) | (c << 6) | d;
+                out.push_back(static_cast<unsigned char>(n >> 16));
+                out.push_back(static_cast<unsigned char>(n >> 8));
+                out.push_back(static_cast<unsigned char>(n));
+                i += 4;
+            }
+            if (i >= len) break;
+        }
+        unsigned v = t[in[i++]];
+        if (v == 65) continue;
+        if (v == 255) throw XMLParseError("Invalid base64 character at offset " + std::to_string(i - 1));
+        if (v == 64) {
+            if (count < 2) throw XMLParseError("Misplaced base64 padding at offset " + std::to_string(i - 1));
+            padding++;
+            v = 0;
+        } else if (padding) {
+            throw XMLParseError("Base64 data after padding at offset " + std::to_string(i - 1));
+        }
+        quad = (quad << 6) | v;
+        if (++count == 4) {
+            out.push_back(static_cast<unsigned char>(quad >> 16));
+            if (padding < 2) out.push_back(static_cast<unsigned char>(quad >> 8));
+            if (padding < 1) out.push_back(static_cast<unsigned char>(quad));
+            quad = 0;
+            count = 0;
+            if (padding) {
+                for (; i < len; ++i) {
+                    if (t[in[i]] != 65) throw XMLParseError("Base64 data after padding at offset " + std::to_string(i));
                 }
-            } else {
-                decoded += text[i++];
             }
         }
-        return decoded;
     }
+    if (count == 1) throw XMLParseError("Truncated base64 input");
+    if (count > 1) {
+        // Padding characters in an unfinished group carry no data.
+        quad <<= 6 * (4 - count);
+        out.push_back(static_cast<unsigned char>(quad >> 16));
+        if (count - padding == 3) out.push_back(static_cast<unsigned char>(quad >> 8));
+    }
+}
 
-    static Node parse_node(const std::string& s, size_t& idx) {
-        skip_ws(s, idx);
-        if (idx >= s.size() || s[idx] != '<') throw XMLParseError("Expected '<' to start a node");
-        idx++;
+// ============ GZIP / DEFLATE DECODING ============
+// Minimal RFC 1951/1952 decoder used by from_file() for .gz inputs. Compressed
+// bytes are read from the stream in fixed-size chunks and inflated straight
+// into the destination string, which doubles as the LZ77 window.
+namespace detail {
+    EXML_INLINE uint32_t crc32(const char* data, size_t len) {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        uint32_t crc = 0xFFFFFFFFu;
+        for (size_t i = 0; i < len; ++i) crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        return crc ^ 0xFFFFFFFFu;
+    }
 
-        // Parse tag name
-        size_t name_start = idx;
-        while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':' || s[idx] == '-')) idx++;
-        Node node(s.substr(name_start, idx - name_start));
+    EXML_INLINE bool is_gzip(std::istream& in) {
+        char magic[2] = {0, 0};
+        in.read(magic, 2);
+        bool gzip = in.gcount() == 2 && static_cast<unsigned char>(magic[0]) == 0x1F && static_cast<unsigned char>(magic[1]) == 0x8B;
+        in.clear();
+        in.seekg(0);
+        return gzip;
+    }
 
-        skip_ws(s, idx);
+    class Inflater {
+    public:
+        Inflater(std::istream& in, std::string& out, size_t max_size) : in(in), out(out), max_size(max_size) {}
 
-        // Parse attributes
-        while (idx < s.size() && s[idx] != '>' && s[idx] != '/') {
-            size_t key_start = idx;
-            while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':')) idx++;
-            std::string key = s.substr(key_start, idx - key_start);
-            skip_ws(s, idx);
-            if (idx >= s.size() || s[idx] != '=') throw XMLParseError("Expected '=' after attribute key");
-            idx++;
-            skip_ws(s, idx);
-            char quote = s[idx];
-            if (quote != '"' && quote != '\'') throw XMLParseError("Attribute value must be quoted");
-            idx++;
-            size_t val_start = idx;
-            while (idx < s.size() && s[idx] != quote) idx++;
-            std::string val = s.substr(val_start, idx - val_start);
-            node.attributes[key] = decode_text(val);
-            idx++;
-            skip_ws(s, idx);
+        // Decodes every gzip member in the stream, appending the payload to out.
+        void gunzip() {
+            do {
+                size_t member_start = out.size();
+                read_gzip_header();
+                inflate();
+                bit_buf >>= bit_count % 8;
+                bit_count -= bit_count % 8;
+                uint32_t crc = read_u32();
+                uint32_t size = read_u32();
+                if (crc != crc32(out.data() + member_start, out.size() - member_start)) throw XMLParseError("gzip CRC mismatch");
+                if (size != static_cast<uint32_t>(out.size() - member_start)) throw XMLParseError("gzip size mismatch");
+            } while (next_member());
         }
 
-        if (idx >= s.size()) throw XMLParseError("Unclosed tag");
-        
-        // Self-closing tag or opening tag
-        if (s[idx] == '/') {
-            idx++;
-            if (idx >= s.size() || s[idx] != '>') throw XMLParseError("Expected '>' for self-closing tag");
-            idx++;
-            return node;
+    private:
+        struct Huffman {
+            uint16_t count[16];
+            uint16_t symbol[288];
+            uint16_t fast[1 << 9];   // (length << 9) | symbol for codes up to 9 bits, 0 otherwise
+        };
+
+        std::istream& in;
+        std::string& out;
+        size_t max_size;
+        char chunk[1 << 16];
+        size_t chunk_pos = 0, chunk_len = 0;
+        uint64_t bit_buf = 0;
+        int bit_count = 0;
+
+        bool fill_chunk() {
+            if (chunk_pos < chunk_len) return true;
+            in.read(chunk, sizeof(chunk));
+            chunk_len = static_cast<size_t>(in.gcount());
+            chunk_pos = 0;
+            return chunk_len > 0;
         }
-        if (s[idx] != '>') throw XMLParseError("Expected '>' to close tag opening");
-        idx++;
-        
-        // Parse content (text and children)
-        size_t content_start = idx;
-        while (idx < s.size()) {
-            skip_ws(s, idx);
-            if (idx + 1 < s.size() && s[idx] == '<' && s[idx+1] == '/') break;
-            if (idx < s.size() && s[idx] == '<') {
-                // Found a child node
-                if(idx > content_start) {
-                    node.text_content += decode_text(s.substr(content_start, idx - content_start));
+
+        void reserve_output(size_t n) {
+            if (n > max_size - std::min(out.size(), max_size)) throw XMLParseError("gzip payload exceeds decompressed size limit");
+        }
+
+        int next_byte() {
+            if (!fill_chunk()) return -1;
+            return static_cast<unsigned char>(chunk[chunk_pos++]);
+        }
+
+        void refill() {
+            while (bit_count <= 56) {
+                int b = next_byte();
+                if (b < 0) break;
+                bit_buf |= static_cast<uint64_t>(b) << bit_count;
+                bit_count += 8;
+            }
+        }
+
+        uint32_t bits(int need) {
+            if (bit_count < need) refill();
+            if (bit_count < need) throw XMLParseError("Unexpected end of gzip data");
+            uint32_t val = static_cast<uint32_t>(bit_buf & ((1ull << need) - 1));
+            bit_buf >>= need;
+            bit_count -= need;
+            return val;
+        }
+
+        uint32_t read_u8() { return bits(8); }
+        uint32_t read_u16() { uint32_t lo = read_u8(); return lo | (read_u8() << 8); }
+        uint32_t read_u32() { uint32_t lo = read_u16(); return lo | (read_u16() << 16); }
+
+        bool next_member() {
+            refill();
+            while (bit_count >= 8 && (bit_buf & 0xFF) == 0) { bit_buf >>= 8; bit_count -= 8; refill(); }
+            if (bit_count == 0) return false;
+            if (bit_count < 16 || (bit_buf & 0xFFFF) != 0x8B1F) throw XMLParseError("Trailing garbage after gzip data");
+            return true;
+        }
+
+        void read_gzip_header() {
+            if (read_u16() != 0x8B1F) throw XMLParseError("Not a gzip stream");
+            if (read_u8() != 8) throw XMLParseError("Unsupported gzip compression method");
+            uint32_t flags = read_u8();
+            for (int i = 0; i < 6; ++i) read_u8();   // mtime, xfl, os
+            if (flags & 4) { uint32_t extra = read_u16(); while (extra--) read_u8(); }
+            if (flags & 8) while (read_u8() != 0) {}
+            if (flags & 16) while (read_u8() != 0) {}
+            if (flags & 2) read_u16();
+        }
+
+        static void build(Huffman& h, const uint8_t* lengths, int n) {
+            std::fill(std::begin(h.count), std::end(h.count), uint16_t(0));
+            std::fill(std::begin(h.fast), std::end(h.fast), uint16_t(0));
+            for (int i = 0; i < n; ++i) h.count[lengths[i]]++;
+            h.count[0] = 0;
+            int left = 1;
+            for (int len = 1; len < 16; ++len) {
+                left = (left << 1) - h.count[len];
+                if (left < 0) throw XMLParseError("Invalid Huffman code lengths");
+            }
+            uint16_t offset[16] = {0};
+            int next_code[16] = {0};
+            for (int len = 1, code = 0; len < 16; ++len) {
+                if (len > 1) offset[len] = static_cast<uint16_t>(offset[len - 1] + h.count[len - 1]);
+                code = (code + h.count[len - 1]) << 1;
+                next_code[len] = code;
+            }
+            for (int sym = 0; sym < n; ++sym) {
+                int len = lengths[sym];
+                if (len == 0) continue;
+                h.symbol[offset[len]++] = static_cast<uint16_t>(sym);
+                int c = next_code[len]++;
+                if (len > 9) continue;
+                int reversed = 0;
+                for (int k = 0; k < len; ++k) reversed |= ((c >> k) & 1) << (len - 1 - k);
+                for (int r = reversed; r < (1 << 9); r += 1 << len) h.fast[r] = static_cast<uint16_t>((len << 9) | sym);
+            }
+        }
+
+        int decode(const Huffman& h) {
+            if (bit_count < 15) refill();
+            uint16_t entry = h.fast[bit_buf & 511];
+            int len = entry >> 9;
+            if (len != 0 && len <= bit_count) {
+                bit_buf >>= len;
+                bit_count -= len;
+                return entry & 511;
+            }
+            int code = 0, first = 0, index = 0;
+            for (len = 1; len < 16 && len <= bit_count; ++len) {
+                code |= static_cast<int>((bit_buf >> (len - 1)) & 1);
+                int count = h.count[len];
+                if (code - first < count) {
+                    bit_buf >>= len;
+                    bit_count -= len;
+                    return h.symbol[index + code - first];
                 }
-                node.child_nodes.push_back(parse_node(s, idx));
-                content_start = idx;
-            } else {
-                idx++;
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
             }
+            throw XMLParseError("Invalid or truncated deflate data");
         }
-        if(idx > content_start) {
-             node.text_content += decode_text(s.substr(content_start, idx - content_start));
+
+        void inflate() {
+            bool last = false;
+            while (!last) {
+                last = bits(1) != 0;
+                uint32_t type = bits(2);
+                if (type == 0) stored_block();
+                else if (type == 1) fixed_block();
+                else if (type == 2) dynamic_block();
+                else throw XMLParseError("Invalid deflate block type");
+            }
         }
 
-        // Closing tag
-        if (idx + 1 >= s.size() || s[idx] != '<' || s[idx+1] != '/') throw XMLParseError("Expected closing tag");
-        idx += 2;
-        size_t close_name_start = idx;
-        while (idx < s.size() && s[idx] != '>') idx++;
-        if (s.substr(close_name_start, idx - close_name_start) != node.name) {
-            throw XMLParseError("Mismatched closing tag: expected " + node.name);
+        void stored_block() {
+            bit_buf >>= bit_count % 8;
+            bit_count -= bit_count % 8;
+            uint32_t len = read_u16();
+            if ((~read_u16() & 0xFFFF) != len) throw XMLParseError("Corrupt stored deflate block");
+            reserve_output(len);
+            while (len > 0 && bit_count >= 8) { out += static_cast<char>(read_u8()); len--; }
+            while (len > 0) {
+                if (!fill_chunk()) throw XMLParseError("Unexpected end of gzip data");
+                size_t take = std::min<size_t>(len, chunk_len - chunk_pos);
+                out.append(chunk + chunk_pos, take);
+                chunk_pos += take;
+                len -= static_cast<uint32_t>(take);
+            }
         }
-        idx++;
-        
-        return node;
+
+        void fixed_block() {
+            static const auto tables = [] {
+                std::pair<Huffman, Huffman> t;
+                uint8_t lengths[288];
+                for (int i = 0; i < 288; ++i) lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+                build(t.first, lengths, 288);
+                std::fill(lengths, lengths + 30, uint8_t(5));
+                build(t.second, lengths, 30);
+                return t;
+            }();
+            codes(tables.first, tables.second);
+        }
+
+        void dynamic_block() {
+            static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            int nlen = static_cast<int>(bits(5)) + 257;
+            int ndist = static_cast<int>(bits(5)) + 1;
+            int ncode = static_cast<int>(bits(4)) + 4;
+            if (nlen > 286 || ndist > 30) throw XMLParseError("Invalid deflate code counts");
+            uint8_t lengths[320] = {0};
+            for (int i = 0; i < ncode; ++i) lengths[order[i]] = static_cast<uint8_t>(bits(3));
+            Huffman lencode, distcode;
+            build(lencode, lengths, 19);
+            for (int i = 0; i < nlen + ndist;) {
+                int sym = decode(lencode);
+                if (sym < 16) { lengths[i++] = static_cast<uint8_t>(sym); continue; }
+                uint8_t repeat_len = 0;
+                int repeat;
+                if (sym == 16) {
+                    if (i == 0) throw XMLParseError("Invalid deflate length repeat");
+                    repeat_len = lengths[i - 1];
+                    repeat = 3 + static_cast<int>(bits(2));
+                } else if (sym == 17) {
+                    repeat = 3 + static_cast<int>(bits(3));
+                } else {
+                    repeat = 11 + static_cast<int>(bits(7));
+                }
+                if (i + repeat > nlen + ndist) throw XMLParseError("Invalid deflate length repeat");
+                while (repeat--) lengths[i++] = repeat_len;
+            }
+            if (lengths[256] == 0) throw XMLParseError("Missing deflate end-of-block code");
+            build(lencode, lengths, nlen);
+            build(distcode, lengths + nlen, ndist);
+            codes(lencode, distcode);
+        }
+
+        void codes(const Huffman& lencode, const Huffman& distcode) {
+            static const uint16_t len_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+            static const uint8_t len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+            static const uint16_t dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+            static const uint8_t dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+            while (true) {
+                int sym = decode(lencode);
+                if (sym < 256) {
+                    reserve_output(1);
+                    out += static_cast<char>(sym);
+                    continue;
+                }
+                if (sym == 256) return;
+                sym -= 257;
+                if (sym >= 29) throw XMLParseError("Invalid deflate length code");
+                size_t len = len_base[sym] + bits(len_extra[sym]);
+                int dsym = decode(distcode);
+                if (dsym >= 30) throw XMLParseError("Invalid deflate distance code");
+                size_t dist = dist_base[dsym] + bits(dist_extra[dsym]);
+                if (dist > out.size()) throw XMLParseError("Deflate distance too far back");
+                reserve_output(len);
+                size_t from = out.size() - dist;
+                size_t to = out.size();
+                out.resize(to + len);
+                char* p = &out[0];
+                for (size_t k = 0; k < len; ++k) p[to + k] = p[from + k];
+            }
+        }
+    };
+
+    EXML_INLINE void gunzip(std::istream& in, std::string& out, size_t max_size) {
+        Inflater(in, out, max_size).gunzip();
     }
-    
-    // ============ SERIALIZER IMPLEMENTATION ============
-    static std::string encode_text(const std::string& text) {
-        std::string encoded;
-        for (char c : text) {
-            switch (c) {
-                case '<': encoded += "&lt;"; break;
-                case '>': encoded += "&gt;"; break;
-                case '&': encoded += "&amp;"; break;
-                case '"': encoded += "&quot;"; break;
-                case '\'': encoded += "&apos;"; break;
-                default: encoded += c;
+}
+
+EXML_INLINE std::string Node::dump(bool pretty, int indent_level, int indent_size) const {
+    EXML_TRACE_BEGIN(dump, pretty);
+    std::ostringstream oss;
+    dump_recursive(oss, pretty, indent_level, indent_size);
+    std::string out = oss.str();
+    EXML_TRACE_END(dump, out.size());
+    return out;
+}
+
+struct Node::ParseContext {
+    struct Entity {
+        std::string value;     // replacement text as declared
+        std::string expanded;  // cached expansion, valid once resolved
+        bool resolved = false;
+        bool expanding = false;
+    };
+
+    // A compiled ParseOptions::select entry.
+    struct Selector {
+        std::vector<std::string> steps;
+        std::string attribute;  // trailing "@name" step, if any
+        bool absolute = false;
+    };
+
+    const ParseOptions& options;
+    std::map<std::string, Entity> entities;
+    size_t expanded_bytes = 0;
+    std::vector<Selector> selectors;
+    bool has_relative = false;
+    bool has_absolute = false;
+    bool relative_anywhere = false;   // a relative selector ends in "*"
+    bool relative_attribute = false;  // a relative selector is a bare "@name"
+    // Results of the last relative probe, by start tag position: elements it
+    // saw close with no candidate inside (and where they end), and elements
+    // still open when it reached a candidate.
+    std::vector<std::pair<size_t, size_t>> probed_clear;
+    std::vector<size_t> probed_holders;
+
+    explicit ParseContext(const ParseOptions& options) : options(options) {
+        for (const auto& text : options.select) {
+            Selector selector;
+            selector.absolute = !text.empty() && text[0] == '/' && text.compare(0, 2, "//") != 0;
+            size_t pos = 0;
+            while (pos <= text.size()) {
+                size_t slash = text.find('/', pos);
+                if (slash == std::string::npos) slash = text.size();
+                std::string step = text.substr(pos, slash - pos);
+                pos = slash + 1;
+                if (step.empty()) continue;
+                if (!selector.attribute.empty()) throw XMLParseError("Attribute step must be last in select path: " + text);
+                if (step[0] == '@') selector.attribute = step.substr(1);
+                else selector.steps.push_back(std::move(step));
             }
+            if (selector.steps.empty() && selector.attribute.empty()) throw XMLParseError("Empty select path");
+            has_relative = has_relative || !selector.absolute;
+            has_absolute = has_absolute || selector.absolute;
+            relative_anywhere = relative_anywhere || (!selector.absolute && !selector.steps.empty() && selector.steps.back() == "*");
+            relative_attribute = relative_attribute || (!selector.absolute && selector.steps.empty());
+            selectors.push_back(std::move(selector));
         }
-        return encoded;
     }
 
-    void dump_recursive(std::ostringstream& oss, bool pretty, int indent_level, int indent_size) const {
-        std::string indent = pretty ? std::string(indent_level * indent_size, ' ') : "";
-        oss << indent << "<" << name;
-        for (const auto& [k, v] : attributes) {
-            oss << " " << k << "=\"" << encode_text(v) << "\"";
+    // Charges bytes of entity output against the per-document budget.
+    void charge(size_t bytes) {
+        expanded_bytes += bytes;
+        if (expanded_bytes > options.max_entity_expansion) throw XMLParseError("Entity expansion limit exceeded");
+    }
+
+    static bool matches(const Selector& selector, const std::vector<std::string_view>& path) {
+        const auto& steps = selector.steps;
+        if (selector.absolute ? steps.size() != path.size() : steps.size() > path.size()) return false;
+        size_t offset = path.size() - steps.size();
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (steps[i] != "*" && steps[i] != path[offset + i]) return false;
         }
+        return true;
+    }
 
-        bool is_empty = text_content.empty() && child_nodes.empty();
-        if (is_empty) {
-            oss << " />" << (pretty ? "\n" : "");
-            return;
+    // The open element is selected and materialized in full.
+    bool selects(const std::vector<std::string_view>& path) const {
+        for (const auto& selector : selectors) {
+            if (selector.attribute.empty() && matches(selector, path)) return true;
         }
+        return false;
+    }
 
-        oss << ">";
-        bool has_children = !child_nodes.empty();
-        if (pretty && has_children) oss << "\n";
-        
-        if (!text_content.empty()) {
-            oss << (pretty && has_children ? std::string((indent_level+1)*indent_size, ' ') : "") 
-                << encode_text(text_content) 
-                << (pretty && has_children ? "\n" : "");
+    // The open element is kept because it carries a selected attribute.
+    bool targets(const std::vector<std::string_view>& path, std::string_view key) const {
+        for (const auto& selector : selectors) {
+            if (selector.attribute == key && matches(selector, path)) return true;
         }
+        return false;
+    }
 
-        for (const auto& child : child_nodes) {
-            child.dump_recursive(oss, pretty, indent_level + 1, indent_size);
+    // An element a relative selector can end on: its last step names it, or
+    // for a bare "@name" selector, it carries that attribute.
+    bool relative_candidate(std::string_view name, std::string_view key) const {
+        for (const auto& selector : selectors) {
+            if (selector.absolute) continue;
+            if (selector.steps.empty() ? selector.attribute == key : key.empty() && selector.steps.back() == name) return true;
         }
+        return false;
+    }
 
-        if (pretty && has_children) oss << indent;
-        oss << "</" << name << ">" << (pretty ? "\n" : "");
+    // Scans the content of the element whose start tag is at start until it
+    // closes (returns false, end past its closing tag) or a relative
+    // candidate appears (returns true). What the scan passed is kept, so the
+    // elements it covered are decided without scanning them again.
+    bool probe_relative(const std::string& s, size_t start, size_t content, size_t& end) {
+        if (std::binary_search(probed_holders.begin(), probed_holders.end(), start)) return true;
+        auto known = std::lower_bound(probed_clear.begin(), probed_clear.end(), std::make_pair(start, size_t(0)));
+        if (known != probed_clear.end() && known->first == start) {
+            end = known->second;
+            return false;
+        }
+        probed_clear.clear();
+        probed_holders.assign(1, start);
+        size_t idx = content;
+        while (true) {
+            idx = s.find('<', idx);
+            if (idx == std::string::npos) throw XMLParseError("Expected closing tag");
+            if (Node::skip_markup(s, idx)) continue;
+            size_t tag = idx++;
+            bool closing = idx < s.size() && s[idx] == '/';
+            if (closing) idx++;
+            size_t name_start = idx;
+            while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':' || s[idx] == '-')) idx++;
+            bool candidate = !closing && relative_candidate(std::string_view(s.data() + name_start, idx - name_start), {});
+            while (idx < s.size() && s[idx] != '>') {
+                if (s[idx] == '"' || s[idx] == '\'') {
+                    size_t close = s.find(s[idx], idx + 1);
+                    if (close == std::string::npos) throw XMLParseError("Unclosed attribute value");
+                    idx = close + 1;
+                } else if (relative_attribute && !closing && !candidate && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':')) {
+                    size_t key_start = idx;
+                    while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':')) idx++;
+                    candidate = relative_candidate({}, std::string_view(s.data() + key_start, idx - key_start));
+                } else {
+                    idx++;
+                }
+            }
+            if (idx >= s.size()) throw XMLParseError("Unclosed tag");
+            bool self_closing = s[idx - 1] == '/';
+            idx++;
+            if (candidate) return true;
+            if (!closing) {
+                if (!self_closing) probed_holders.push_back(tag);
+                continue;
+            }
+            size_t closed = probed_holders.back();
+            probed_holders.pop_back();
+            if (probed_holders.empty()) {
+                end = idx;
+                return false;
+            }
+            // Entries after closed lie inside it and are never asked about.
+            while (!probed_clear.empty() && probed_clear.back().first > closed) probed_clear.pop_back();
+            probed_clear.emplace_back(closed, idx);
+        }
     }
-};
+
+    // An element starting at idx that the last relative probe saw close with
+    // no candidate inside, when no absolute selector could pick it either.
+    bool skip_probed(size_t& idx) const {
+        if (has_absolute || probed_clear.empty()) return false;
+        auto known = std::lower_bound(probed_clear.begin(), probed_clear.end(), std::make_pair(idx, size_t(0)));
+        if (known == probed_clear.end() || known->first != idx) return false;
+        idx = known->second;
+        return true;
+    }
+
+    // Some selector can still match below the open element, whose start tag
+    // spans [start, content). When a relative probe rules it out, end is set
+    // past its closing tag.
+    bool may_contain(const std::vector<std::string_view>& path, const std::string& s, size_t start, size_t content, size_t& end) {
+        for (const auto& selector : selectors) {
+            if (!selector.absolute) continue;
+            const auto& steps = selector.steps;
+            if (steps.size() <= path.size()) continue;
+            size_t i = 0;
+            while (i < path.size() && (steps[i] == "*" || steps[i] == path[i])) ++i;
+            if (i == path.size()) return true;
+        }
+        if (!has_relative) return false;
+        return relative_anywhere || probe_relative(s, start, content, end);
+    }
+};
+
+EXML_INLINE Node Node::parse(const std::string& s) {
+    return parse(s, ParseOptions());
+}
+
+EXML_INLINE Node Node::parse(const std::string& s, const ParseOptions& options) {
+    EXML_TRACE_BEGIN(parse, s.size());
+    ParseContext ctx(options);
+    size_t idx = 0;
+    skip_ws_and_prolog(s, idx, ctx);
+    Node root;
+    if (ctx.selectors.empty()) {
+        root = parse_node(s, idx, ctx);
+    } else {
+        std::vector<std::string_view> path;
+        parse_selected(s, idx, ctx, path, root);
+    }
+    skip_ws(s, idx);
+    if (idx < s.size()) {
+        throw XMLParseError("Extra characters after root element at position " + std::to_string(idx));
+    }
+    EXML_TRACE_END(parse, s.size());
+    return root;
+}
+
+EXML_INLINE Node Node::from_file(const std::string& filename, size_t max_inflated_size) {
+    EXML_TRACE_BEGIN(from_file, filename.c_str());
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        throw XMLParseError("Cannot open file: " + filename);
+    }
+    std::string content;
+    if (detail::is_gzip(file)) {
+        detail::gunzip(file, content, max_inflated_size);
+    } else {
+        content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    Node root = parse(content);
+    EXML_TRACE_END(from_file, content.size());
+    return root;
+}
+
+EXML_INLINE void Node::to_file(const std::string& filename, bool pretty) const {
+    EXML_TRACE_BEGIN(to_file, filename.c_str());
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw XMLParseError("Cannot write to file: " + filename);
+    }
+    std::string text = dump(pretty);
+    file << text;
+    EXML_TRACE_END(to_file, text.size());
+}
+
+EXML_INLINE void Node::skip_ws(const std::string& s, size_t& idx) {
+    while (idx < s.size() && std::isspace(s[idx])) idx++;
+}
+
+EXML_INLINE void Node::skip_ws_and_prolog(const std::string& s, size_t& idx, ParseContext& ctx) {
+    while (idx < s.size()) {
+        skip_ws(s, idx);
+        if (idx + 1 >= s.size() || s[idx] != '<') break;
+        if (s.compare(idx, 9, "<!DOCTYPE") == 0) {
+            parse_doctype(s, idx, ctx);
+        } else if (s.compare(idx, 4, "<!--") == 0) {
+            auto end_pos = s.find("-->", idx + 4);
+            if (end_pos == std::string::npos) throw XMLParseError("Unclosed comment");
+            idx = end_pos + 3;
+        } else if (s[idx+1] == '?' || s[idx+1] == '!') {
+             auto end_pos = s.find('>', idx);
+             if (end_pos == std::string::npos) throw XMLParseError("Unclosed prolog/comment");
+             idx = end_pos + 1;
+        } else {
+            break;
+        }
+    }
+}
+
+EXML_INLINE void Node::parse_doctype(const std::string& s, size_t& idx, ParseContext& ctx) {
+    size_t start = idx;
+    idx += 9;
+    auto read_literal = [&s, &idx, start]() {
+        char quote = s[idx];
+        size_t close = s.find(quote, idx + 1);
+        if (close == std::string::npos) throw XMLParseError("Unclosed literal in DOCTYPE at position " + std::to_string(start));
+        std::string literal = s.substr(idx + 1, close - idx - 1);
+        idx = close + 1;
+        return literal;
+    };
+    // Skips a declaration or any other markup, stepping over quoted literals.
+    auto skip_markup = [&]() {
+        while (idx < s.size() && s[idx] != '>') {
+            if (s[idx] == '"' || s[idx] == '\'') read_literal();
+            else idx++;
+        }
+        if (idx >= s.size()) throw XMLParseError("Unclosed DOCTYPE declaration");
+        idx++;
+    };
+
+    while (idx < s.size() && s[idx] != '[' && s[idx] != '>') {
+        if (s[idx] == '"' || s[idx] == '\'') read_literal();
+        else idx++;
+    }
+    if (idx < s.size() && s[idx] == '[') {
+        idx++;
+        while (true) {
+            skip_ws(s, idx);
+            if (idx >= s.size()) throw XMLParseError("Unclosed DOCTYPE internal subset");
+            if (s[idx] == ']') {
+                idx++;
+                break;
+            }
+            if (s.compare(idx, 4, "<!--") == 0) {
+                auto end_pos = s.find("-->", idx + 4);
+                if (end_pos == std::string::npos) throw XMLParseError("Unclosed comment");
+                idx = end_pos + 3;
+            } else if (s.compare(idx, 8, "<!ENTITY") == 0) {
+                idx += 8;
+                skip_ws(s, idx);
+                bool parameter = idx < s.size() && s[idx] == '%';
+                if (parameter) {
+                    idx++;
+                    skip_ws(s, idx);
+                }
+                size_t name_start = idx;
+                while (idx < s.size() && !std::isspace(static_cast<unsigned char>(s[idx])) && s[idx] != '>') idx++;
+                std::string name = s.substr(name_start, idx - name_start);
+                skip_ws(s, idx);
+                // Only internal general entities are expanded; external and
+                // parameter entities are skipped.
+                if (idx < s.size() && (s[idx] == '"' || s[idx] == '\'')) {
+                    std::string value = read_literal();
+                    if (!parameter && !name.empty() && !ctx.entities.count(name)) {
+                        if (ctx.entities.size() >= ctx.options.max_entities) throw XMLParseError("Too many entity declarations");
+                        ctx.entities[name].value = std::move(value);
+                    }
+                }
+                skip_markup();
+            } else if (s[idx] == '<') {
+                skip_markup();
+            } else {
+                idx++;  // parameter entity references and stray characters
+            }
+        }
+        skip_ws(s, idx);
+    }
+    if (idx >= s.size() || s[idx] != '>') throw XMLParseError("Unclosed DOCTYPE at position " + std::to_string(start));
+    idx++;
+}
+
+EXML_INLINE std::string Node::parse_entity(const std::string& entity, ParseContext& ctx, size_t depth) {
+    if (entity == "lt") return "<";
+    if (entity == "gt") return ">";
+    if (entity == "amp") return "&";
+    if (entity == "quot") return "\"";
+    if (entity == "apos") return "'";
+    if (ctx.options.expand_entities) {
+        auto it = ctx.entities.find(entity);
+        if (it != ctx.entities.end()) {
+            auto& declared = it->second;
+            if (depth >= ctx.options.max_entity_depth) throw XMLParseError("Entity nesting too deep: " + entity);
+            if (!declared.resolved) {
+                if (declared.expanding) throw XMLParseError("Recursive entity: " + entity);
+                declared.expanding = true;
+                declared.expanded = decode_text(declared.value, ctx, depth + 1);
+                declared.expanding = false;
+                declared.resolved = true;
+            }
+            ctx.charge(declared.expanded.size());
+            return declared.expanded;
+        }
+    }
+    return "&" + entity + ";";
+}
+
+EXML_INLINE std::string Node::decode_text(const std::string& text, ParseContext& ctx, size_t depth) {
+    std::string decoded;
+    size_t i = 0;
+    while (i < text.length()) {
+        if (text[i] == '&') {
+            size_t semi_pos = text.find(';', i);
+            if (semi_pos != std::string::npos) {
+                std::string entity = text.substr(i + 1, semi_pos - i - 1);
+                decoded += parse_entity(entity, ctx, depth);
+                i = semi_pos + 1;
+            } else {
+                decoded += '&'; // Malformed entity
+                i++;
+            }
+        } else {
+            decoded += text[i++];
+        }
+    }
+    return decoded;
+}
+
+EXML_INLINE void Node::parse_attributes(const std::string& s, size_t& idx, Node& node, ParseContext& ctx) {
+    skip_ws(s, idx);
+    while (idx < s.size() && s[idx] != '>' && s[idx] != '/') {
+        size_t key_start = idx;
+        while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':')) idx++;
+        std::string key = s.substr(key_start, idx - key_start);
+        skip_ws(s, idx);
+        if (idx >= s.size() || s[idx] != '=') throw XMLParseError("Expected '=' after attribute key");
+        idx++;
+        skip_ws(s, idx);
+        char quote = s[idx];
+        if (quote != '"' && quote != '\'') throw XMLParseError("Attribute value must be quoted");
+        idx++;
+        size_t val_start = idx;
+        while (idx < s.size() && s[idx] != quote) idx++;
+        std::string val = s.substr(val_start, idx - val_start);
+        node.attributes[key] = decode_text(val, ctx);
+        idx++;
+        skip_ws(s, idx);
+    }
+}
+
+EXML_INLINE bool Node::skip_attributes(const std::string& s, size_t& idx) {
+    bool found = false;
+    skip_ws(s, idx);
+    while (idx < s.size() && s[idx] != '>' && s[idx] != '/') {
+        while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':')) idx++;
+        skip_ws(s, idx);
+        if (idx >= s.size() || s[idx] != '=') throw XMLParseError("Expected '=' after attribute key");
+        idx++;
+        skip_ws(s, idx);
+        if (idx >= s.size() || (s[idx] != '"' && s[idx] != '\'')) throw XMLParseError("Attribute value must be quoted");
+        size_t close = s.find(s[idx], idx + 1);
+        if (close == std::string::npos) throw XMLParseError("Unclosed attribute value");
+        idx = close + 1;
+        found = true;
+        skip_ws(s, idx);
+    }
+    return found;
+}
+
+EXML_INLINE Node Node::parse_node(const std::string& s, size_t& idx, ParseContext& ctx) {
+    skip_ws(s, idx);
+    if (idx >= s.size() || s[idx] != '<') throw XMLParseError("Expected '<' to start a node");
+    idx++;
+
+    // Parse tag name
+    size_t name_start = idx;
+    while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':' || s[idx] == '-')) idx++;
+    Node node(s.substr(name_start, idx - name_start));
+
+    if (ctx.options.lazy_attributes && ctx.entities.empty()) {
+        size_t attributes_start = idx;
+        if (skip_attributes(s, idx)) node.pending.raw = std::make_unique<std::string>(s, attributes_start, idx - attributes_start);
+    } else {
+        parse_attributes(s, idx, node, ctx);
+    }
+
+    if (idx >= s.size()) throw XMLParseError("Unclosed tag");
+    
+    // Self-closing tag or opening tag
+    if (s[idx] == '/') {
+        idx++;
+        if (idx >= s.size() || s[idx] != '>') throw XMLParseError("Expected '>' for self-closing tag");
+        idx++;
+        return node;
+    }
+    if (s[idx] != '>') throw XMLParseError("Expected '>' to close tag opening");
+    idx++;
+    
+    // Parse content (text and children)
+    size_t content_start = idx;
+    while (idx < s.size()) {
+        skip_ws(s, idx);
+        if (idx + 1 < s.size() && s[idx] == '<' && s[idx+1] == '/') break;
+        if (idx < s.size() && s[idx] == '<') {
+            // Found a child node
+            if(idx > content_start) {
+                node.text_content += decode_text(s.substr(content_start, idx - content_start), ctx);
+            }
+            node.child_nodes.push_back(parse_node(s, idx, ctx));
+            content_start = idx;
+        } else {
+            idx++;
+        }
+    }
+    if(idx > content_start) {
+         node.text_content += decode_text(s.substr(content_start, idx - content_start), ctx);
+    }
+
+    // Closing tag
+    if (idx + 1 >= s.size() || s[idx] != '<' || s[idx+1] != '/') throw XMLParseError("Expected closing tag");
+    idx += 2;
+    size_t close_name_start = idx;
+    while (idx < s.size() && s[idx] != '>') idx++;
+    if (s.substr(close_name_start, idx - close_name_start) != node.name) {
+        throw XMLParseError("Mismatched closing tag: expected " + node.name);
+    }
+    idx++;
+    
+    return node;
+}
+
+// The pending text was validated by skip_attributes() at parse time, so it is
+// walked here without error checks. Yields each name and its still-encoded
+// value; returns false at the end.
+EXML_INLINE bool Node::next_pending_attribute(const std::string& raw, size_t& i, std::string_view& key, std::string_view& value) {
+    while (i < raw.size() && std::isspace(static_cast<unsigned char>(raw[i]))) i++;
+    if (i >= raw.size()) return false;
+    size_t key_start = i;
+    while (std::isalnum(raw[i]) || raw[i] == '_' || raw[i] == ':') i++;
+    key = std::string_view(raw).substr(key_start, i - key_start);
+    size_t open = raw.find_first_of("\"'", i);
+    size_t close = raw.find(raw[open], open + 1);
+    value = std::string_view(raw).substr(open + 1, close - open - 1);
+    i = close + 1;
+    return true;
+}
+
+// Later duplicates win, as when parsing eagerly.
+EXML_INLINE std::optional<std::string> Node::find_pending_attribute(const std::string& key) const {
+    std::string_view found_value;
+    bool found = false;
+    std::string_view k, v;
+    for (size_t i = 0; next_pending_attribute(*pending.raw, i, k, v);) {
+        if (k == key) {
+            found_value = v;
+            found = true;
+        }
+    }
+    if (!found) return std::nullopt;
+    ParseOptions options;
+    ParseContext ctx(options);
+    return decode_text(std::string(found_value), ctx);
+}
+
+EXML_INLINE size_t Node::pending_attribute_count() const {
+    std::vector<std::string_view> keys;
+    std::string_view k, v;
+    for (size_t i = 0; next_pending_attribute(*pending.raw, i, k, v);) keys.push_back(k);
+    std::sort(keys.begin(), keys.end());
+    return std::unique(keys.begin(), keys.end()) - keys.begin();
+}
+
+EXML_INLINE std::map<std::string, std::string> Node::pending_attribute_map() const {
+    Node decoded;
+    ParseOptions options;
+    ParseContext ctx(options);
+    size_t idx = 0;
+    parse_attributes(*pending.raw, idx, decoded, ctx);
+    return std::move(decoded.attributes);
+}
+
+EXML_INLINE std::map<std::string, std::string>& Node::load_attributes() {
+    if (pending.raw) {
+        for (auto& [k, v] : pending_attribute_map()) attributes.emplace(k, std::move(v));
+        pending.raw.reset();
+    }
+    return attributes;
+}
+
+EXML_INLINE bool Node::parse_selected(const std::string& s, size_t& idx, ParseContext& ctx,
+                                      std::vector<std::string_view>& path, Node& out) {
+    skip_ws(s, idx);
+    if (idx >= s.size() || s[idx] != '<') throw XMLParseError("Expected '<' to start a node");
+    size_t start = idx++;
+
+    size_t name_start = idx;
+    while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':' || s[idx] == '-')) idx++;
+    std::string_view name(s.data() + name_start, idx - name_start);
+    path.push_back(name);
+
+    if (ctx.selects(path)) {
+        idx = start;
+        out = parse_node(s, idx, ctx);
+        path.pop_back();
+        return true;
+    }
+
+    // Attributes are only scanned here; they are decoded if the element is kept.
+    size_t attributes_start = idx;
+    bool kept = path.size() == 1;
+    skip_ws(s, idx);
+    while (idx < s.size() && s[idx] != '>' && s[idx] != '/') {
+        size_t key_start = idx;
+        while (idx < s.size() && (std::isalnum(s[idx]) || s[idx] == '_' || s[idx] == ':')) idx++;
+        std::string_view key(s.data() + key_start, idx - key_start);
+        kept = kept || ctx.targets(path, key);
+        skip_ws(s, idx);
+        if (idx >= s.size() || s[idx] != '=') throw XMLParseError("Expected '=' after attribute key");
+        idx++;
+        skip_ws(s, idx);
+        if (idx >= s.size() || (s[idx] != '"' && s[idx] != '\'')) throw XMLParseError("Attribute value must be quoted");
+        size_t close = s.find(s[idx], idx + 1);
+        if (close == std::string::npos) throw XMLParseError("Unclosed attribute value");
+        idx = close + 1;
+        skip_ws(s, idx);
+    }
+    if (idx >= s.size()) throw XMLParseError("Unclosed tag");
+
+    size_t end = std::string::npos;
+    if (s[idx] == '/') {
+        idx++;
+        if (idx >= s.size() || s[idx] != '>') throw XMLParseError("Expected '>' for self-closing tag");
+        idx++;
+    } else if (ctx.may_contain(path, s, start, idx + 1, end)) {
+        idx++;
+        while (true) {
+            idx = s.find('<', idx);
+            if (idx == std::string::npos) throw XMLParseError("Expected closing tag");
+            if (s.compare(idx, 2, "</") == 0) break;
+            if (skip_markup(s, idx) || ctx.skip_probed(idx)) continue;
+            Node child;
+            if (parse_selected(s, idx, ctx, path, child)) out.child_nodes.push_back(std::move(child));
+        }
+        idx += 2;
+        size_t close_name_start = idx;
+        while (idx < s.size() && s[idx] != '>') idx++;
+        if (std::string_view(s.data() + close_name_start, idx - close_name_start) != name) {
+            throw XMLParseError("Mismatched closing tag: expected " + std::string(name));
+        }
+        idx++;
+    } else if (end != std::string::npos) {
+        idx = end;  // already scanned by a relative probe
+    } else {
+        idx++;
+        skip_element_content(s, idx);
+    }
+    path.pop_back();
+
+    if (!kept && out.child_nodes.empty()) return false;
+    out.name = std::string(name);
+    parse_attributes(s, attributes_start, out, ctx);
+    return true;
+}
+
+// Steps over a comment, CDATA section, processing instruction or other <!...>
+// declaration at idx. Returns false if idx starts an element or closing tag.
+EXML_INLINE bool Node::skip_markup(const std::string& s, size_t& idx) {
+    // Most tags are elements; rule them out before comparing prefixes.
+    if (idx + 1 >= s.size() || (s[idx + 1] != '!' && s[idx + 1] != '?')) return false;
+    const char* terminator;
+    if (s.compare(idx, 4, "<!--") == 0) terminator = "-->";
+    else if (s.compare(idx, 9, "<![CDATA[") == 0) terminator = "]]>";
+    else if (s.compare(idx, 2, "<?") == 0) terminator = "?>";
+    else if (s.compare(idx, 2, "<!") == 0) terminator = ">";
+    else return false;
+    size_t end_pos = s.find(terminator, idx + 2);
+    if (end_pos == std::string::npos) throw XMLParseError("Unclosed markup at position " + std::to_string(idx));
+    idx = end_pos + std::strlen(terminator);
+    return true;
+}
+
+// Skips to just past the closing tag of an element whose start tag ends
+// before idx, counting tag depth without copying anything.
+EXML_INLINE void Node::skip_element_content(const std::string& s, size_t& idx) {
+    size_t depth = 1;
+    while (depth > 0) {
+        idx = s.find('<', idx);
+        if (idx == std::string::npos) throw XMLParseError("Expected closing tag");
+        if (skip_markup(s, idx)) continue;
+        bool closing = idx + 1 < s.size() && s[idx + 1] == '/';
+        idx++;
+        while (idx < s.size() && s[idx] != '>') {
+            if (s[idx] == '"' || s[idx] == '\'') {
+                size_t close = s.find(s[idx], idx + 1);
+                if (close == std::string::npos) throw XMLParseError("Unclosed attribute value");
+                idx = close + 1;
+            } else {
+                idx++;
+            }
+        }
+        if (idx >= s.size()) throw XMLParseError("Unclosed tag");
+        if (closing) depth--;
+        else if (s[idx - 1] != '/') depth++;
+        idx++;
+    }
+}
+
+EXML_INLINE std::string Node::encode_text(const std::string& text) {
+    std::string encoded;
+    for (char c : text) {
+        switch (c) {
+            case '<': encoded += "&lt;"; break;
+            case '>': encoded += "&gt;"; break;
+            case '&': encoded += "&amp;"; break;
+            case '"': encoded += "&quot;"; break;
+            case '\'': encoded += "&apos;"; break;
+            default: encoded += c;
+        }
+    }
+    return encoded;
+}
+
+EXML_INLINE void Node::dump_recursive(std::ostringstream& oss, bool pretty, int indent_level, int indent_size) const {
+    std::string indent = pretty ? std::string(indent_level * indent_size, ' ') : "";
+    oss << indent << "<" << name;
+    for_each_attribute([&oss](const std::string& k, const std::string& v) {
+        oss << " " << k << "=\"" << encode_text(v) << "\"";
+    });
+
+    bool is_empty = text_content.empty() && child_nodes.empty();
+    if (is_empty) {
+        oss << " />" << (pretty ? "\n" : "");
+        return;
+    }
+
+    oss << ">";
+    bool has_children = !child_nodes.empty();
+    if (pretty && has_children) oss << "\n";
+    
+    if (!text_content.empty()) {
+        oss << (pretty && has_children ? std::string((indent_level+1)*indent_size, ' ') : "") 
+            << encode_text(text_content) 
+            << (pretty && has_children ? "\n" : "");
+    }
+
+    for (const auto& child : child_nodes) {
+        child.dump_recursive(oss, pretty, indent_level + 1, indent_size);
+    }
+
+    if (pretty && has_children) oss << indent;
+    oss << "</" << name << ">" << (pretty ? "\n" : "");
+}
+
+// ============ WELL-FORMEDNESS CHECK ============
+namespace detail {
+    inline bool is_name_start(unsigned char c) {
+        return std::isalpha(c) || c == '_' || c == ':' || c >= 0x80;
+    }
+
+    inline bool is_name_char(unsigned char c) {
+        return is_name_start(c) || std::isdigit(c) || c == '-' || c == '.';
+    }
+
+    inline bool is_xml_space(char c) {
+        return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+    }
+
+    // Validates the reference starting at s[i] == '&' and returns the index
+    // just past its ';', or npos when it is malformed.
+    inline size_t check_entity(std::string_view s, size_t i, bool allow_declared) {
+        size_t j = i + 1;
+        if (j < s.size() && s[j] == '#') {
+            ++j;
+            bool hex = j < s.size() && s[j] == 'x';
+            if (hex) ++j;
+            size_t start = j;
+            while (j < s.size() && (hex ? std::isxdigit(static_cast<unsigned char>(s[j])) : std::isdigit(static_cast<unsigned char>(s[j])))) ++j;
+            if (j == start || j >= s.size() || s[j] != ';') return std::string_view::npos;
+            return j + 1;
+        }
+        size_t start = j;
+        if (j >= s.size() || !is_name_start(static_cast<unsigned char>(s[j]))) return std::string_view::npos;
+        while (j < s.size() && is_name_char(static_cast<unsigned char>(s[j]))) ++j;
+        if (j >= s.size() || s[j] != ';') return std::string_view::npos;
+        std::string_view name = s.substr(start, j - start);
+        if (!allow_declared && name != "lt" && name != "gt" && name != "amp" && name != "quot" && name != "apos") return std::string_view::npos;
+        return j + 1;
+    }
+
+    inline size_t scan_name(std::string_view s, size_t i) {
+        if (i >= s.size() || !is_name_start(static_cast<unsigned char>(s[i]))) return i;
+        ++i;
+        while (i < s.size() && is_name_char(static_cast<unsigned char>(s[i]))) ++i;
+        return i;
+    }
+}
+
+EXML_INLINE WellFormedness is_well_formed(std::string_view s) {
+    using W = WellFormedness;
+    auto fail = [](W::Code code, size_t offset) {
+        W result;
+        result.code = code;
+        result.offset = offset;
+        return result;
+    };
+
+    std::array<std::pair<uint32_t, uint32_t>, W::max_depth> open{};  // name offset, length
+    size_t depth = 0;
+    bool seen_root = false;
+    bool has_doctype = false;
+    size_t i = 0;
+    if (s.size() >= 3 && static_cast<unsigned char>(s[0]) == 0xEF && static_cast<unsigned char>(s[1]) == 0xBB && static_cast<unsigned char>(s[2]) == 0xBF) i = 3;
+
+    while (i < s.size()) {
+        if (s[i] != '<') {
+            // Character data: jump to the next markup or reference.
+            size_t lt = s.find('<', i);
+            size_t end = lt == std::string_view::npos ? s.size() : lt;
+            for (size_t amp = s.find('&', i); amp < end; amp = s.find('&', amp)) {
+                if (depth == 0) return fail(W::ContentOutsideRoot, amp);
+                size_t next = detail::check_entity(s, amp, has_doctype);
+                if (next == std::string_view::npos) return fail(W::BadEntity, amp);
+                amp = next;
+            }
+            if (depth == 0) {
+                for (size_t k = i; k < end; ++k) {
+                    if (!detail::is_xml_space(s[k])) return fail(W::ContentOutsideRoot, k);
+                }
+            }
+            i = end;
+            continue;
+        }
+
+        size_t start = i;
+        if (s.compare(i, 4, "<!--") == 0) {
+            size_t end = s.find("--", i + 4);
+            if (end == std::string_view::npos) return fail(W::UnexpectedEnd, start);
+            if (end + 2 >= s.size() || s[end + 2] != '>') return fail(W::BadMarkup, end);
+            i = end + 3;
+        } else if (s.compare(i, 9, "<![CDATA[") == 0) {
+            if (depth == 0) return fail(W::ContentOutsideRoot, start);
+            size_t end = s.find("]]>", i + 9);
+            if (end == std::string_view::npos) return fail(W::UnexpectedEnd, start);
+            i = end + 3;
+        } else if (s.compare(i, 2, "<?") == 0) {
+            size_t name_end = detail::scan_name(s, i + 2);
+            if (name_end == i + 2) return fail(W::BadMarkup, i + 2);
+            size_t end = s.find("?>", name_end);
+            if (end == std::string_view::npos) return fail(W::UnexpectedEnd, start);
+            i = end + 2;
+        } else if (s.compare(i, 9, "<!DOCTYPE") == 0) {
+            if (seen_root || has_doctype) return fail(W::BadMarkup, start);
+            has_doctype = true;
+            // Skip to the matching '>', stepping over the internal subset and quoted literals.
+            size_t brackets = 0;
+            i += 9;
+            while (true) {
+                if (i >= s.size()) return fail(W::UnexpectedEnd, start);
+                char c = s[i];
+                if (c == '"' || c == '\'') {
+                    size_t close = s.find(c, i + 1);
+                    if (close == std::string_view::npos) return fail(W::UnexpectedEnd, i);
+                    i = close + 1;
+                    continue;
+                }
+                ++i;
+                if (c == '[') ++brackets;
+                else if (c == ']' && brackets) --brackets;
+                else if (c == '>' && brackets == 0) break;
+            }
+        } else if (s.compare(i, 2, "</") == 0) {
+            size_t name_end = detail::scan_name(s, i + 2);
+            if (name_end == i + 2) return fail(W::InvalidName, i + 2);
+            if (depth == 0) return fail(W::MismatchedTag, start);
+            const auto& top = open[depth - 1];
+            if (name_end - (i + 2) != top.second || s.compare(i + 2, top.second, s.substr(top.first, top.second)) != 0) {
+                return fail(W::MismatchedTag, start);
+            }
+            i = name_end;
+            while (i < s.size() && detail::is_xml_space(s[i])) ++i;
+            if (i >= s.size()) return fail(W::UnexpectedEnd, start);
+            if (s[i] != '>') return fail(W::BadMarkup, i);
+            ++i;
+            --depth;
+        } else {
+            size_t name_start = i + 1;
+            size_t name_end = detail::scan_name(s, name_start);
+            if (name_end == name_start) return fail(name_start >= s.size() ? W::UnexpectedEnd : W::InvalidName, name_start);
+            if (depth == 0 && seen_root) return fail(W::ContentOutsideRoot, start);
+            std::array<std::pair<uint32_t, uint32_t>, W::max_attributes> attrs{};
+            size_t attr_count = 0;
+            i = name_end;
+            bool self_closing = false;
+            while (true) {
+                size_t before = i;
+                while (i < s.size() && detail::is_xml_space(s[i])) ++i;
+                if (i >= s.size()) return fail(W::UnexpectedEnd, start);
+                if (s[i] == '>') {
+                    ++i;
+                    break;
+                }
+                if (s[i] == '/') {
+                    if (i + 1 >= s.size()) return fail(W::UnexpectedEnd, start);
+                    if (s[i + 1] != '>') return fail(W::BadMarkup, i);
+                    i += 2;
+                    self_closing = true;
+                    break;
+                }
+                if (i == before) return fail(W::BadAttribute, i);  // attributes need leading whitespace
+                size_t attr_start = i;
+                size_t attr_end = detail::scan_name(s, i);
+                if (attr_end == attr_start) return fail(W::InvalidName, i);
+                std::string_view attr_name = s.substr(attr_start, attr_end - attr_start);
+                for (size_t a = 0; a < attr_count; ++a) {
+                    if (s.substr(attrs[a].first, attrs[a].second) == attr_name) return fail(W::DuplicateAttribute, attr_start);
+                }
+                if (attr_count < attrs.size()) attrs[attr_count++] = {static_cast<uint32_t>(attr_start), static_cast<uint32_t>(attr_name.size())};
+                i = attr_end;
+                while (i < s.size() && detail::is_xml_space(s[i])) ++i;
+                if (i >= s.size()) return fail(W::UnexpectedEnd, start);
+                if (s[i] != '=') return fail(W::BadAttribute, i);
+                ++i;
+                while (i < s.size() && detail::is_xml_space(s[i])) ++i;
+                if (i >= s.size()) return fail(W::UnexpectedEnd, start);
+                char quote = s[i];
+                if (quote != '"' && quote != '\'') return fail(W::BadAttribute, i);
+                size_t close = s.find(quote, i + 1);
+                if (close == std::string_view::npos) return fail(W::UnexpectedEnd, i);
+                for (size_t k = i + 1; k < close; ++k) {
+                    if (s[k] == '<') return fail(W::BadAttribute, k);
+                    if (s[k] == '&') {
+                        size_t next = detail::check_entity(s, k, has_doctype);
+                        if (next == std::string_view::npos || next > close) return fail(W::BadEntity, k);
+                        k = next - 1;
+                    }
+                }
+                i = close + 1;
+            }
+            seen_root = true;
+            if (!self_closing) {
+                if (depth == open.size()) return fail(W::TooDeep, start);
+                open[depth++] = {static_cast<uint32_t>(name_start), static_cast<uint32_t>(name_end - name_start)};
+            }
+        }
+    }
+    if (depth > 0) return fail(W::UnexpectedEnd, s.size());
+    if (!seen_root) return fail(W::NoRoot, s.size());
+    return W();
+}
+
+// ============ BINARY ENCODING ============
+// Layout: "EXB1", then the root element. An element is
+//   name, attribute count, (name, value)*, text, child count, child*
+// where counts are varints, names are dictionary ids (0 = new name, followed
+// by its length and bytes), and values/texts are 0 + length + bytes for a
+// literal or n for the (n-1)-th short value seen earlier.
+namespace detail {
+    constexpr size_t binary_value_max_length = 32;
+    constexpr size_t binary_table_limit = 1 << 16;
+
+    struct BinaryEncoder {
+        std::string out;
+        std::map<std::string, size_t> names;
+        std::map<std::string, size_t> values;
+
+        void varint(uint64_t v) {
+            while (v >= 0x80) {
+                out += static_cast<char>((v & 0x7F) | 0x80);
+                v >>= 7;
+            }
+            out += static_cast<char>(v);
+        }
+
+        void bytes(const std::string& s) {
+            varint(s.size());
+            out += s;
+        }
+
+        void name(const std::string& s) {
+            auto it = names.find(s);
+            if (it != names.end()) {
+                varint(it->second);
+                return;
+            }
+            varint(0);
+            bytes(s);
+            names.emplace(s, names.size() + 1);
+        }
+
+        void value(const std::string& s) {
+            if (s.size() > binary_value_max_length) {
+                varint(0);
+                bytes(s);
+                return;
+            }
+            auto it = values.find(s);
+            if (it != values.end()) {
+                varint(it->second);
+                return;
+            }
+            varint(0);
+            bytes(s);
+            if (values.size() < binary_table_limit) values.emplace(s, values.size() + 1);
+        }
+
+        void node(const Node& n) {
+            name(n.name);
+            varint(n.attribute_count());
+            n.for_each_attribute([this](const std::string& k, const std::string& v) {
+                name(k);
+                value(v);
+            });
+            value(n.text_content);
+            varint(n.child_nodes.size());
+            for (const auto& child : n.child_nodes) node(child);
+        }
+    };
+
+    struct BinaryDecoder {
+        static constexpr uint64_t min_node_size = 4;
+
+        const unsigned char* p;
+        const unsigned char* end;
+        std::vector<std::string> names;
+        std::vector<std::string> values;
+
+        uint64_t varint() {
+            uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (p >= end) throw XMLParseError("Truncated binary XML");
+                unsigned char b = *p++;
+                v |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80)) return v;
+            }
+            throw XMLParseError("Malformed varint in binary XML");
+        }
+
+        std::string bytes() {
+            uint64_t len = varint();
+            if (len > static_cast<uint64_t>(end - p)) throw XMLParseError("Truncated binary XML");
+            std::string s(reinterpret_cast<const char*>(p), static_cast<size_t>(len));
+            p += len;
+            return s;
+        }
+
+        const std::string& name() {
+            uint64_t id = varint();
+            if (id == 0) {
+                names.push_back(bytes());
+                return names.back();
+            }
+            if (id > names.size()) throw XMLParseError("Invalid name reference in binary XML");
+            return names[id - 1];
+        }
+
+        std::string value() {
+            uint64_t id = varint();
+            if (id == 0) {
+                std::string s = bytes();
+                if (s.size() <= binary_value_max_length && values.size() < binary_table_limit) values.push_back(s);
+                return s;
+            }
+            if (id > values.size()) throw XMLParseError("Invalid value reference in binary XML");
+            return values[id - 1];
+        }
+
+        void node(Node& n, int depth) {
+            if (depth > 4096) throw XMLParseError("Binary XML nested too deeply");
+            n.name = name();
+            uint64_t attrs = varint();
+            if (attrs > static_cast<uint64_t>(end - p) / 2) throw XMLParseError("Truncated binary XML");
+            for (uint64_t i = 0; i < attrs; ++i) {
+                std::string key = name();
+                n.attributes[key] = value();
+            }
+            n.text_content = value();
+            // A node takes at least min_node_size bytes (name, attribute count,
+            // text and child count), so counts the input cannot hold are
+            // rejected up front; children are appended as they are decoded.
+            uint64_t children = varint();
+            if (children > static_cast<uint64_t>(end - p) / min_node_size) throw XMLParseError("Truncated binary XML");
+            for (uint64_t i = 0; i < children; ++i) {
+                n.child_nodes.emplace_back();
+                node(n.child_nodes.back(), depth + 1);
+            }
+        }
+    };
+}
+
+EXML_INLINE std::string Node::to_binary() const {
+    detail::BinaryEncoder encoder;
+    encoder.out = "EXB1";
+    encoder.node(*this);
+    return std::move(encoder.out);
+}
+
+EXML_INLINE Node Node::from_binary(const char* data, size_t len) {
+    if (len < 4 || std::memcmp(data, "EXB1", 4) != 0) throw XMLParseError("Not a binary XML document");
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+    detail::BinaryDecoder decoder{begin + 4, begin + len, {}, {}};
+    Node root;
+    decoder.node(root, 0);
+    if (decoder.p != decoder.end) throw XMLParseError("Unexpected data after binary XML document");
+    return root;
+}
+
+// ============ SHAPE PROFILING ============
+EXML_INLINE void ShapeProfile::Histogram::add(size_t n) {
+    size_t bucket = 0;
+    for (size_t v = n; v; v >>= 1) ++bucket;
+    ++buckets[bucket];
+    ++count;
+    max = std::max(max, n);
+    total += static_cast<double>(n);
+}
+
+EXML_INLINE void ShapeProfile::Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < buckets.size(); ++i) buckets[i] += other.buckets[i];
+    count += other.count;
+    max = std::max(max, other.max);
+    total += other.total;
+}
+
+EXML_INLINE size_t ShapeProfile::Histogram::percentile(double p) const {
+    size_t target = static_cast<size_t>(p * static_cast<double>(count));
+    size_t seen = 0;
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        seen += buckets[b];
+        if (seen > target || seen == count) return b == 0 ? 0 : std::min(max, (size_t(1) << (b - 1)) * 2 - 1);
+    }
+    return max;
+}
+
+EXML_INLINE Node ShapeProfile::Histogram::to_node(const std::string& name) const {
+    Node out(name);
+    out.set_attribute("count", std::to_string(count))
+       .set_attribute("max", std::to_string(max))
+       .set_attribute("mean", std::to_string(count ? total / static_cast<double>(count) : 0.0))
+       .set_attribute("p50", std::to_string(percentile(0.5)))
+       .set_attribute("p90", std::to_string(percentile(0.9)))
+       .set_attribute("p99", std::to_string(percentile(0.99)));
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        if (!buckets[b]) continue;
+        Node bucket("bucket", std::to_string(buckets[b]));
+        bucket.set_attribute("min", b == 0 ? "0" : std::to_string(size_t(1) << (b - 1)));
+        out.add_child(std::move(bucket));
+    }
+    return out;
+}
+
+EXML_INLINE void ShapeProfile::count_value(const std::string& value) {
+    if (value.size() > max_value_length) return;
+    auto it = value_counts.find(value);
+    if (it != value_counts.end()) ++it->second;
+    else if (value_counts.size() < max_tracked_values) value_counts.emplace(value, 1);
+}
+
+EXML_INLINE void ShapeProfile::walk(const Node& node, size_t depth, std::string& path, size_t& max_depth) {
+    max_depth = std::max(max_depth, depth);
+    size_t mark = path.size();
+    path += '/';
+    path += node.name;
+    auto slot = path_counts.find(path);
+    if (slot != path_counts.end()) ++slot->second;
+    else if (path_counts.size() < max_tracked_paths) path_counts.emplace(path, 1);
+
+    ++elements;
+    ++element_names[node.name];
+    child_counts.add(node.child_nodes.size());
+    size_t attributes_seen = 0;
+    node.for_each_attribute([this, &attributes_seen](const std::string& k, const std::string& v) {
+        ++attributes_seen;
+        ++attribute_names[k];
+        count_value(v);
+    });
+    attribute_counts.add(attributes_seen);
+    if (!node.text_content.empty()) {
+        text_lengths.add(node.text_content.size());
+        count_value(node.text_content);
+    }
+    for (const auto& child : node.child_nodes) walk(child, depth + 1, path, max_depth);
+    path.resize(mark);
+}
+
+EXML_INLINE void ShapeProfile::add(const Node& doc) {
+    std::string path;
+    size_t max_depth = 0;
+    walk(doc, 0, path, max_depth);
+    depths.add(max_depth);
+    ++docs;
+}
+
+EXML_INLINE void ShapeProfile::add_file(const std::string& path) {
+    add(Node::from_file(path));
+}
+
+EXML_INLINE void ShapeProfile::merge(const ShapeProfile& other) {
+    docs += other.docs;
+    elements += other.elements;
+    depths.merge(other.depths);
+    child_counts.merge(other.child_counts);
+    attribute_counts.merge(other.attribute_counts);
+    text_lengths.merge(other.text_lengths);
+    for (const auto& [k, n] : other.element_names) element_names[k] += n;
+    for (const auto& [k, n] : other.attribute_names) attribute_names[k] += n;
+    for (const auto& [v, n] : other.value_counts) {
+        auto it = value_counts.find(v);
+        if (it != value_counts.end()) it->second += n;
+        else if (value_counts.size() < max_tracked_values) value_counts.emplace(v, n);
+    }
+    for (const auto& [p, n] : other.path_counts) {
+        auto it = path_counts.find(p);
+        if (it != path_counts.end()) it->second += n;
+        else if (path_counts.size() < max_tracked_paths) path_counts.emplace(p, n);
+    }
+}
+
+EXML_INLINE ShapeProfile ShapeProfile::profile_files(const std::vector<std::string>& paths, unsigned threads) {
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(1, paths.size())));
+    std::vector<std::future<ShapeProfile>> parts;
+    for (unsigned t = 0; t < threads; ++t) {
+        parts.push_back(std::async(std::launch::async, [&paths, threads, t] {
+            ShapeProfile part;
+            for (size_t i = t; i < paths.size(); i += threads) part.add_file(paths[i]);
+            return part;
+        }));
+    }
+    ShapeProfile result;
+    for (auto& part : parts) result.merge(part.get());
+    return result;
+}
+
+EXML_INLINE Node ShapeProfile::report() const {
+    Node out("shape-profile");
+    out.set_attribute("documents", std::to_string(docs))
+       .set_attribute("elements", std::to_string(elements));
+    out.add_child(depths.to_node("depth"));
+    out.add_child(child_counts.to_node("child-counts"));
+    out.add_child(attribute_counts.to_node("attribute-counts"));
+    out.add_child(text_lengths.to_node("text-lengths"));
+
+    Node names("element-names");
+    for (const auto& [k, n] : element_names) names.add_child(Node("name", k).set_attribute("count", std::to_string(n)));
+    out.add_child(std::move(names));
+    Node attrs("attribute-names");
+    for (const auto& [k, n] : attribute_names) attrs.add_child(Node("name", k).set_attribute("count", std::to_string(n)));
+    out.add_child(std::move(attrs));
+
+    std::vector<std::pair<size_t, const std::string*>> repeats;
+    size_t repeated_total = 0;
+    for (const auto& [v, n] : value_counts) {
+        if (n < 2) continue;
+        repeats.emplace_back(n, &v);
+        repeated_total += n;
+    }
+    std::sort(repeats.begin(), repeats.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+    Node repeated("repeated-values");
+    for (size_t i = 0; i < repeats.size() && i < 20; ++i) {
+        repeated.add_child(Node("value", *repeats[i].second).set_attribute("count", std::to_string(repeats[i].first)));
+    }
+    out.add_child(std::move(repeated));
+
+    Node paths("paths");
+    for (const auto& [p, n] : path_counts) paths.add_child(Node("path", p).set_attribute("count", std::to_string(n)));
+    out.add_child(std::move(paths));
+
+    // Reserve hint covers 90% of elements; interning pays off once a
+    // sizeable share of text and attribute values are repeats.
+    Node hints("suggestions");
+    hints.set_attribute("child-reserve", std::to_string(child_counts.percentile(0.9)))
+         .set_attribute("attribute-reserve", std::to_string(attribute_counts.percentile(0.9)))
+         .set_attribute("intern-values", repeated_total * 4 >= text_lengths.count + static_cast<size_t>(attribute_counts.total) ? "true" : "false");
+    out.add_child(std::move(hints));
+    return out;
+}
+
+// ============ FROZEN DOCUMENTS ============
+EXML_INLINE FrozenDocument Node::freeze() const {
+    return FrozenDocument(*this);
+}
+
+EXML_INLINE FrozenDocument::FrozenDocument(const Node& root) {
+    uint32_t post_counter = 0;
+    add(root, npos, post_counter);
+}
+
+EXML_INLINE uint32_t FrozenDocument::intern(const std::string& element_name) {
+    auto it = name_ids.find(element_name);
+    if (it != name_ids.end()) return it->second;
+    uint32_t name_id = static_cast<uint32_t>(names.size());
+    names.push_back(element_name);
+    postings.emplace_back();
+    name_ids.emplace(element_name, name_id);
+    return name_id;
+}
+
+EXML_INLINE uint32_t FrozenDocument::lookup(std::string_view element_name) const {
+    auto it = name_ids.find(element_name);
+    return it == name_ids.end() ? npos : it->second;
+}
+
+// Appends node and its subtree in preorder; children are linked as they are
+// added, and postorder numbers are assigned on the way back up.
+EXML_INLINE uint32_t FrozenDocument::add(const Node& node, uint32_t parent, uint32_t& post_counter) {
+    if (entries.size() >= npos) throw XMLParseError("Document too large to freeze");
+    uint32_t pre = static_cast<uint32_t>(entries.size());
+    uint32_t name_id = intern(node.name);
+    postings[name_id].push_back(pre);
+
+    uint32_t attr_begin = static_cast<uint32_t>(attrs.size());
+    node.for_each_attribute([this](const std::string& k, const std::string& v) { attrs.emplace_back(k, v); });
+    entries.push_back({name_id, parent, npos, npos, pre, 0, attr_begin, static_cast<uint32_t>(attrs.size())});
+    texts.push_back(node.text_content);
+
+    uint32_t prev = npos;
+    for (const auto& child : node.child_nodes) {
+        uint32_t child_pre = add(child, pre, post_counter);
+        if (prev == npos) entries[pre].first_child = child_pre;
+        else entries[prev].next_sibling = child_pre;
+        prev = child_pre;
+    }
+    entries[pre].subtree_end = static_cast<uint32_t>(entries.size() - 1);
+    entries[pre].post = post_counter++;
+    return pre;
+}
+
+EXML_INLINE std::vector<FrozenNode> FrozenDocument::collect(uint32_t name_id, uint32_t first, uint32_t last) const {
+    std::vector<FrozenNode> result;
+    if (name_id == npos || first > last) return result;
+    const auto& list = postings[name_id];
+    auto lo = std::lower_bound(list.begin(), list.end(), first);
+    auto hi = std::upper_bound(lo, list.end(), last);
+    result.reserve(static_cast<size_t>(hi - lo));
+    for (auto it = lo; it != hi; ++it) result.push_back(FrozenNode(this, *it));
+    return result;
+}
+
+EXML_INLINE std::vector<FrozenNode> FrozenDocument::find_all(std::string_view element_name) const {
+    if (entries.empty()) return {};
+    return collect(lookup(element_name), 0, static_cast<uint32_t>(entries.size() - 1));
+}
+
+EXML_INLINE size_t FrozenDocument::count(std::string_view element_name) const {
+    uint32_t name_id = lookup(element_name);
+    return name_id == npos ? 0 : postings[name_id].size();
+}
+
+EXML_INLINE uint32_t FrozenNode::post() const { return doc->entries[id].post; }
+EXML_INLINE uint32_t FrozenNode::subtree_end() const { return doc->entries[id].subtree_end; }
+EXML_INLINE std::string_view FrozenNode::name() const { return doc->names[doc->entries[id].name]; }
+EXML_INLINE std::string_view FrozenNode::text() const { return doc->texts[id]; }
+
+EXML_INLINE size_t FrozenNode::attribute_count() const {
+    const auto& entry = doc->entries[id];
+    return entry.attr_end - entry.attr_begin;
+}
+
+EXML_INLINE std::optional<std::string_view> FrozenNode::attribute(std::string_view key) const {
+    const auto& entry = doc->entries[id];
+    auto first = doc->attrs.begin() + entry.attr_begin;
+    auto last = doc->attrs.begin() + entry.attr_end;
+    auto it = std::lower_bound(first, last, key, [](const std::pair<std::string, std::string>& attr, std::string_view k) {
+        return std::string_view(attr.first) < k;
+    });
+    if (it == last || it->first != key) return std::nullopt;
+    return std::string_view(it->second);
+}
+
+EXML_INLINE FrozenNode FrozenNode::parent() const {
+    uint32_t p = doc->entries[id].parent;
+    return p == FrozenDocument::npos ? FrozenNode() : FrozenNode(doc, p);
+}
+
+EXML_INLINE FrozenNode FrozenNode::first_child() const {
+    uint32_t c = doc->entries[id].first_child;
+    return c == FrozenDocument::npos ? FrozenNode() : FrozenNode(doc, c);
+}
+
+EXML_INLINE FrozenNode FrozenNode::next_sibling() const {
+    uint32_t s = doc->entries[id].next_sibling;
+    return s == FrozenDocument::npos ? FrozenNode() : FrozenNode(doc, s);
+}
+
+EXML_INLINE FrozenNode FrozenNode::child(std::string_view child_name) const {
+    uint32_t name_id = doc->lookup(child_name);
+    if (name_id == FrozenDocument::npos) return FrozenNode();
+    for (uint32_t c = doc->entries[id].first_child; c != FrozenDocument::npos; c = doc->entries[c].next_sibling) {
+        if (doc->entries[c].name == name_id) return FrozenNode(doc, c);
+    }
+    return FrozenNode();
+}
+
+EXML_INLINE std::vector<FrozenNode> FrozenNode::children(std::string_view child_name) const {
+    std::vector<FrozenNode> result;
+    uint32_t name_id = doc->lookup(child_name);
+    if (name_id == FrozenDocument::npos) return result;
+    for (uint32_t c = doc->entries[id].first_child; c != FrozenDocument::npos; c = doc->entries[c].next_sibling) {
+        if (doc->entries[c].name == name_id) result.push_back(FrozenNode(doc, c));
+    }
+    return result;
+}
+
+EXML_INLINE std::vector<FrozenNode> FrozenNode::descendants(std::string_view descendant_name) const {
+    return doc->collect(doc->lookup(descendant_name), id + 1, doc->entries[id].subtree_end);
+}
+
+EXML_INLINE bool FrozenNode::is_ancestor_of(const FrozenNode& other) const {
+    return doc == other.doc && id < other.id && post() > other.post();
+}
+
+EXML_INLINE Node FrozenNode::to_node() const {
+    Node node{std::string(name()), std::string(text())};
+    const auto& entry = doc->entries[id];
+    for (uint32_t a = entry.attr_begin; a < entry.attr_end; ++a) {
+        node.attributes.emplace_hint(node.attributes.end(), doc->attrs[a].first, doc->attrs[a].second);
+    }
+    for (FrozenNode c = first_child(); c; c = c.next_sibling()) node.child_nodes.push_back(c.to_node());
+    return node;
+}
+
+#if defined(EXML_COMPILED)
+template int Node::as<int>(int) const;
+template long Node::as<long>(long) const;
+template long long Node::as<long long>(long long) const;
+template float Node::as<float>(float) const;
+template double Node::as<double>(double) const;
+template std::string Node::as<std::string>(std::string) const;
+#endif
 
 } // namespace exml
+#endif // !EXML_COMPILED || EXML_IMPLEMENTATION
 
 // ============ USAGE EXAMPLES ============
 /*